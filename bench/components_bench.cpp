@@ -0,0 +1,96 @@
+// Микробенчмарк связных компонент: cv::connectedComponentsWithStats против разметки полосами
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include "common/parallel_components.h"
+#include "common/red_classifier.h"
+#include "common/hole_detector.h"
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+// Маска красного синтетической мишени: пробоины, конфетти и длинные штрихи через границы полос
+Mat makeSyntheticMask(int width, int height, uint64 seed) {
+    Mat mask = Mat::zeros(height, width, CV_8UC1);
+    RNG rng(seed);
+    for (int i = 0; i < 400; ++i) {
+        Point p(rng.uniform(0, width), rng.uniform(0, height));
+        circle(mask, p, rng.uniform(1, width / 150 + 3), Scalar(255), -1);
+    }
+    for (int i = 0; i < 2000; ++i) {
+        mask.at<uchar>(rng.uniform(0, height), rng.uniform(0, width)) = 255;
+    }
+    for (int i = 0; i < 20; ++i) {
+        Point a(rng.uniform(0, width), rng.uniform(0, height));
+        Point b(rng.uniform(0, width), rng.uniform(0, height));
+        line(mask, a, b, Scalar(255), rng.uniform(1, 4));
+    }
+    return mask;
+}
+
+template <typename F>
+double timeMs(F f, int iterations) {
+    f();  // прогрев
+    int64 start = getTickCount();
+    for (int i = 0; i < iterations; ++i) f();
+    return (getTickCount() - start) * 1000.0 / getTickFrequency() / iterations;
+}
+
+// Число строк stats/centroids, которые не совпали с эталоном
+int compareStats(const Mat& ref_stats, const Mat& ref_centroids, const Mat& stats, const Mat& centroids) {
+    if (ref_stats.rows != stats.rows) return abs(ref_stats.rows - stats.rows) + 1;
+    int mismatches = 0;
+    for (int i = 0; i < stats.rows; ++i) {
+        bool same = true;
+        for (int j = 0; j < 5; ++j) same &= ref_stats.at<int>(i, j) == stats.at<int>(i, j);
+        for (int j = 0; j < 2; ++j) same &= abs(ref_centroids.at<double>(i, j) - centroids.at<double>(i, j)) < 1e-6;
+        if (!same) mismatches++;
+    }
+    return mismatches;
+}
+
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 2 ? atoi(argv[2]) : 5;
+
+    vector<Mat> masks;
+    if (argc > 1) {
+        Mat image = imread(argv[1]);
+        if (image.empty()) {
+            cerr << "Cannot load " << argv[1] << endl;
+            return -1;
+        }
+        Mat mask;
+        RedPixelClassifier(HoleDetector::redHsvRanges()).classify(image, mask);
+        masks.push_back(mask);
+    } else {
+        masks.push_back(makeSyntheticMask(4000, 3000, 1));   // 12 MP
+        masks.push_back(makeSyntheticMask(6000, 4000, 2));   // 24 MP
+        masks.push_back(makeSyntheticMask(8000, 6000, 3));   // 48 MP
+        masks.push_back(makeSyntheticMask(333, 257, 4));     // нечетные размеры, мало полос
+    }
+
+    cout << setw(12) << "size" << setw(12) << "labels" << setw(14) << "opencv ms" << setw(12) << "strips ms"
+         << setw(10) << "speedup" << setw(12) << "mismatch" << endl;
+
+    int mismatches = 0;
+    for (const auto& mask : masks) {
+        Mat labels, ref_stats, ref_centroids, stats, centroids;
+        int n = 0;
+        double ref_ms = timeMs([&] { n = connectedComponentsWithStats(mask, labels, ref_stats, ref_centroids); }, iterations);
+        double fast_ms = timeMs([&] { connectedComponentStats(mask, stats, centroids); }, iterations);
+        int mask_mismatches = compareStats(ref_stats, ref_centroids, stats, centroids);
+        mismatches += mask_mismatches;
+
+        cout << setw(12) << (to_string(mask.cols) + "x" + to_string(mask.rows)) << setw(12) << n
+             << setw(14) << fixed << setprecision(2) << ref_ms << setw(12) << fast_ms
+             << setw(9) << setprecision(2) << ref_ms / fast_ms << "x"
+             << setw(12) << mask_mismatches << endl;
+    }
+
+    return mismatches == 0 ? 0 : 1;
+}
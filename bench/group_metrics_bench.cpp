@@ -0,0 +1,85 @@
+// Бенчмарк пересчета метрик групп: поштучный ShootingMetricsCalculator против пакетного computeGroupMetrics
+#include <opencv2/core.hpp>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <cstdlib>
+#include "common/shooting_metrics.h"
+#include "common/group_metrics.h"
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+double elapsedMs(int64 start) {
+    return (getTickCount() - start) * 1000.0 / getTickFrequency();
+}
+
+// Группы вокруг случайных центров листа A3 в см, разброс 1-5 см
+void makeGroups(size_t count, int shots, uint64 seed, ShotGroups& groups) {
+    RNG rng(seed);
+    groups.clear();
+    vector<Point2f> group(shots);
+    for (size_t g = 0; g < count; ++g) {
+        Point2f center((float)rng.uniform(5.0, 25.0), (float)rng.uniform(5.0, 37.0));
+        double spread = rng.uniform(1.0, 5.0);
+        for (auto& p : group) p = center + Point2f((float)rng.gaussian(spread), (float)rng.gaussian(spread));
+        groups.add(group);
+    }
+}
+
+}
+
+// group_metrics_bench [число групп]
+int main(int argc, char** argv) {
+    const size_t count = argc > 1 ? (size_t)atoll(argv[1]) : 1000000;
+    const int threads = getNumThreads();
+
+    cout << setw(8) << "shots" << setw(16) << "scalar g/s" << setw(16) << "batch 1t g/s" << setw(16) << "batch g/s"
+         << setw(14) << "max diff" << endl;
+    for (int shots : { 4, 10 }) {
+        ShotGroups groups;
+        makeGroups(count, shots, 12345 + shots, groups);
+
+        // Поштучно, как при анализе снимка (последовательное построение СТП)
+        ShootingMetricsCalculator calc;
+        vector<Point2f> group(shots);
+        vector<ShootingMetrics> scalar(count);
+        int64 start = getTickCount();
+        for (size_t g = 0; g < count; ++g) {
+            const size_t begin = g * shots;
+            for (int i = 0; i < shots; ++i) group[i] = Point2f(groups.x[begin + i], groups.y[begin + i]);
+            scalar[g] = calc.calculateMetrics(group, 1.0);
+        }
+        const double scalar_ms = elapsedMs(start);
+
+        GroupMetricsBatch batch;
+        computeGroupMetrics(groups, batch);     // прогрев и выделение выходных массивов
+
+        setNumThreads(1);
+        start = getTickCount();
+        computeGroupMetrics(groups, batch);
+        const double single_ms = elapsedMs(start);
+
+        setNumThreads(threads);
+        start = getTickCount();
+        computeGroupMetrics(groups, batch);
+        const double batch_ms = elapsedMs(start);
+
+        // Расхождение с поштучным расчетом - только округление float
+        double max_diff = 0.0;
+        for (size_t g = 0; g < count; ++g) {
+            max_diff = max(max_diff, (double)fabs(batch.stp_x[g] - scalar[g].stp.x));
+            max_diff = max(max_diff, (double)fabs(batch.stp_y[g] - scalar[g].stp.y));
+            max_diff = max(max_diff, fabs(batch.mean_radius[g] - scalar[g].precision));
+            max_diff = max(max_diff, fabs(batch.max_radius[g] - scalar[g].group_radius));
+        }
+
+        cout << setw(8) << shots << fixed << setprecision(0) << setw(16) << count * 1000.0 / scalar_ms
+             << setw(16) << count * 1000.0 / single_ms << setw(16) << count * 1000.0 / batch_ms
+             << setw(14) << scientific << setprecision(2) << max_diff << defaultfloat << endl;
+        if (max_diff > 1e-3) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+// Бенчмарк истории стрельб: дозапись и запросы по миллионам записей
+#include <opencv2/core.hpp>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include "common/shot_history.h"
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+double elapsedMs(int64 start) {
+    return (getTickCount() - start) * 1000.0 / getTickFrequency();
+}
+
+const char* SHOOTERS[] = { "ivanov", "petrov", "sidorov", "kuznetsov", "smirnov" };
+const char* WEAPONS[] = { "pm", "ak", "rifle" };
+
+}
+
+// history_bench <каталог> [число записей]; каталог должен быть пустым или отсутствовать
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <empty dir> [records]" << endl;
+        return -1;
+    }
+    const string directory = argv[1];
+    const int records = argc > 2 ? atoi(argv[2]) : 2000000;
+
+    // Записи раз в 5 минут: 2 млн записей - около 19 лет
+    RNG rng(12345);
+    int64 start = getTickCount();
+    {
+        ShotHistoryWriter writer;
+        if (!writer.open(directory) || writer.size() != 0) {
+            cerr << "Cannot create an empty history in " << directory << endl;
+            return -1;
+        }
+        HistoryRecord r;
+        for (int i = 0; i < records; ++i) {
+            r.timestamp = 1500000000LL + (int64_t)i * 300;
+            r.shooter = SHOOTERS[rng.uniform(0, 5)];
+            r.weapon = WEAPONS[rng.uniform(0, 3)];
+            r.group_radius_cm = rng.uniform(1.0, 12.0);
+            r.precision_cm = r.group_radius_cm * 0.6;
+            r.stp_offset_cm = Point2f((float)rng.gaussian(2.0), (float)rng.gaussian(2.0));
+            r.distance_to_center_cm = norm(r.stp_offset_cm);
+            r.holes_cm.assign(10, Point2f());
+            writer.append(r);
+        }
+    }
+    cout << "Append " << records << " records: " << fixed << setprecision(1) << elapsedMs(start) << " ms" << endl;
+
+    start = getTickCount();
+    ShotHistoryReader reader;
+    if (!reader.open(directory) || reader.size() != (size_t)records) {
+        cerr << "Cannot read the history back" << endl;
+        return 1;
+    }
+    cout << "Open: " << elapsedMs(start) << " ms" << endl;
+
+    HistoryQuery all;
+    HistoryQuery shooter;
+    shooter.shooter = "petrov";
+    shooter.weapon = "ak";
+    HistoryQuery year = shooter;
+    year.from = 1500000000LL + (int64_t)records * 150;
+    year.to = year.from + 365LL * 86400;
+
+    const struct {
+        const char* name;
+        const HistoryQuery& query;
+    } queries[] = { { "all", all }, { "shooter+weapon", shooter }, { "shooter+weapon, 1 year", year } };
+
+    cout << setw(24) << "query" << setw(12) << "rows" << setw(14) << "summary ms" << setw(12) << "trend ms"
+         << setw(12) << "p95 ms" << endl;
+    for (const auto& q : queries) {
+        start = getTickCount();
+        HistorySummary summary = reader.summarize(q.query);
+        double summary_ms = elapsedMs(start);
+
+        start = getTickCount();
+        vector<HistoryBucket> months = reader.trend(q.query, 30 * 86400);
+        double trend_ms = elapsedMs(start);
+
+        start = getTickCount();
+        vector<uint32_t> rows = reader.select(q.query);
+        reader.percentile(rows, HistoryColumn::DistanceToCenterCm, 0.95);
+        double percentile_ms = elapsedMs(start);
+
+        cout << setw(24) << q.name << setw(12) << summary.count << setw(14) << setprecision(2) << summary_ms
+             << setw(12) << trend_ms << setw(12) << percentile_ms << endl;
+        if (months.empty() && summary.count > 0) return 1;
+    }
+    return 0;
+}
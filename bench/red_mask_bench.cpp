@@ -0,0 +1,100 @@
+// Микробенчмарк маски красного: cvtColor + inRange + bitwise_or против табличного классификатора
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include "common/hole_detector.h"
+#include "common/red_classifier.h"
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+// Светлая бумага с шумом, красные пробоины и черное яблочко
+Mat makeSyntheticTarget(int width, int height) {
+    Mat image(height, width, CV_8UC3);
+    randn(image, Scalar(205, 210, 215), Scalar(25, 25, 25));
+
+    RNG rng(12345);
+    circle(image, Point(width / 2, (int)(height * 0.666)), width / 6, Scalar(20, 20, 20), -1);
+    for (int i = 0; i < 200; ++i) {
+        Point p(rng.uniform(0, width), rng.uniform(0, height));
+        int radius = rng.uniform(width / 400 + 1, width / 150 + 2);
+        circle(image, p, radius, Scalar(rng.uniform(0, 60), rng.uniform(0, 60), rng.uniform(150, 256)), -1);
+    }
+    return image;
+}
+
+template <typename F>
+double timeMs(F f, int iterations) {
+    f();  // прогрев
+    int64 start = getTickCount();
+    for (int i = 0; i < iterations; ++i) f();
+    return (getTickCount() - start) * 1000.0 / getTickFrequency() / iterations;
+}
+
+// Полный перебор всех 2^24 цветов одним изображением 4096x4096
+int64 exhaustiveMismatches(const RedPixelClassifier& classifier) {
+    Mat cube(4096, 4096, CV_8UC3);
+    for (int y = 0; y < cube.rows; ++y) {
+        Vec3b* row = cube.ptr<Vec3b>(y);
+        for (int x = 0; x < cube.cols; ++x) {
+            uint32_t c = ((uint32_t)y << 12) | (uint32_t)x;
+            row[x] = Vec3b((uchar)(c >> 16), (uchar)(c >> 8), (uchar)c);
+        }
+    }
+
+    Mat ref, fast, diff;
+    classifier.classifyReference(cube, ref);
+    classifier.classify(cube, fast);
+    bitwise_xor(ref, fast, diff);
+    return countNonZero(diff);
+}
+
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 2 ? atoi(argv[2]) : 5;
+
+    int64 start = getTickCount();
+    RedPixelClassifier classifier(HoleDetector::redHsvRanges());
+    cout << "Table build: " << fixed << setprecision(1)
+         << (getTickCount() - start) * 1000.0 / getTickFrequency() << " ms" << endl;
+
+    int64 mismatches = exhaustiveMismatches(classifier);
+    cout << "Exhaustive 2^24 color check: " << mismatches << " mismatches" << endl;
+
+    vector<Mat> images;
+    if (argc > 1) {
+        Mat image = imread(argv[1]);
+        if (image.empty()) {
+            cerr << "Cannot load " << argv[1] << endl;
+            return -1;
+        }
+        images.push_back(image);
+    } else {
+        images.push_back(makeSyntheticTarget(4000, 3000));   // 12 MP
+        images.push_back(makeSyntheticTarget(6000, 4000));   // 24 MP
+        images.push_back(makeSyntheticTarget(8000, 6000));   // 48 MP
+    }
+
+    cout << setw(12) << "size" << setw(14) << "reference ms" << setw(12) << "fused ms"
+         << setw(10) << "speedup" << setw(12) << "mismatch" << endl;
+
+    for (const auto& image : images) {
+        Mat ref, fast, diff;
+        double ref_ms = timeMs([&] { classifier.classifyReference(image, ref); }, iterations);
+        double fast_ms = timeMs([&] { classifier.classify(image, fast); }, iterations);
+        bitwise_xor(ref, fast, diff);
+        int image_mismatches = countNonZero(diff);
+        mismatches += image_mismatches;
+
+        cout << setw(12) << (to_string(image.cols) + "x" + to_string(image.rows))
+             << setw(14) << setprecision(2) << ref_ms << setw(12) << fast_ms
+             << setw(9) << setprecision(2) << ref_ms / fast_ms << "x"
+             << setw(12) << image_mismatches << endl;
+    }
+
+    return mismatches == 0 ? 0 : 1;
+}
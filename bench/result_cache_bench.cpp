@@ -0,0 +1,149 @@
+// Бенчмарк кэша результатов: анализ, сохранение, повторное открытие и чтение; результаты из кэша
+// должны совпасть со свежим анализом, а свежий анализ - не зависеть от порядка снимков
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "synthetic_target.h"
+#include "common/batch_processor.h"
+#include "common/result_cache.h"
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+double elapsedMs(int64 start) {
+    return (getTickCount() - start) * 1000.0 / getTickFrequency();
+}
+
+bool samePoint(const Point2f& a, const Point2f& b) {
+    return a.x == b.x && a.y == b.y;
+}
+
+// Кэш хранит числа побитово, поэтому сравнение точное; путь в кэш не входит
+bool sameResult(const BatchItemResult& a, const BatchItemResult& b, string& why) {
+    if (a.ok != b.ok || a.error != b.error) why = "status";
+    else if (a.pixels_per_cm != b.pixels_per_cm || a.decode_reduction != b.decode_reduction) why = "scale";
+    else if (a.holes.size() != b.holes.size()) why = "hole count";
+    else if (a.detections.size() != b.detections.size()) why = "detection count";
+    else {
+        for (size_t i = 0; i < a.holes.size() && why.empty(); ++i) {
+            if (!samePoint(a.holes[i], b.holes[i])) why = "hole " + to_string(i);
+        }
+        for (size_t i = 0; i < a.detections.size() && why.empty(); ++i) {
+            if (!samePoint(a.detections[i].center, b.detections[i].center) ||
+                a.detections[i].pixel_count != b.detections[i].pixel_count) {
+                why = "detection " + to_string(i);
+            }
+        }
+        const ShootingMetrics& m = a.metrics;
+        const ShootingMetrics& n = b.metrics;
+        if (why.empty() && (m.precision != n.precision || m.group_radius != n.group_radius || !samePoint(m.stp, n.stp) ||
+            m.precision_cm != n.precision_cm || m.group_radius_cm != n.group_radius_cm ||
+            m.distance_to_center_cm != n.distance_to_center_cm || !samePoint(m.target_center, n.target_center))) {
+            why = "metrics";
+        }
+    }
+    return why.empty();
+}
+
+int countMismatches(const char* stage, const vector<string>& paths, const vector<BatchItemResult>& expected,
+    const vector<BatchItemResult>& actual) {
+    int mismatches = 0;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        string why;
+        if (!sameResult(expected[i], actual[i], why)) {
+            cerr << stage << ": " << paths[i] << " differs (" << why << ")" << endl;
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+}
+
+// result_cache_bench <каталог> [число снимков]; каталог должен быть пустым или отсутствовать
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <empty dir> [images]" << endl;
+        return -1;
+    }
+    const string directory = argv[1];
+    const int images = max(1, argc > 2 ? atoi(argv[2]) : 20);
+
+    BatchOptions options;
+    ResultCache cache;
+    string error;
+    if (!cache.open(directory, 256 << 20, &error) || cache.bytes() != 0) {
+        cerr << "Cannot create an empty cache in " << directory << ": " << error << endl;
+        return -1;
+    }
+
+    // Снимки с разными центрами мишени и числом пробоин: результат одного не должен влиять на другой
+    vector<string> paths;
+    for (int i = 0; i < images; ++i) {
+        SyntheticTargetOptions target_options;
+        target_options.width = 2000;
+        target_options.holes = 4 + i % 7;
+        target_options.confetti = i % 3 * 20;
+        target_options.seed = (unsigned int)(i + 1);
+        SyntheticTarget target = generateSyntheticTarget(target_options);
+        paths.push_back(directory + "/target_" + to_string(i) + ".jpg");
+        if (!imwrite(paths.back(), target.image)) {
+            cerr << "Cannot write " << paths.back() << endl;
+            return -1;
+        }
+    }
+
+    int64 start = getTickCount();
+    vector<BatchItemResult> fresh(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) fresh[i] = BatchProcessor::processFile(paths[i], options);
+    const double fresh_ms = elapsedMs(start);
+
+    vector<BatchItemResult> reversed(paths.size());
+    for (size_t i = paths.size(); i-- > 0;) reversed[i] = BatchProcessor::processFile(paths[i], options);
+
+    options.cache = &cache;
+    start = getTickCount();
+    vector<BatchItemResult> stored(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) stored[i] = BatchProcessor::processFile(paths[i], options);
+    const double store_ms = elapsedMs(start);
+    cache.close();
+
+    ResultCache reopened;
+    if (!reopened.open(directory, 256 << 20, &error)) {
+        cerr << "Cannot reopen the cache: " << error << endl;
+        return 1;
+    }
+    options.cache = &reopened;
+    start = getTickCount();
+    vector<BatchItemResult> reloaded(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) reloaded[i] = BatchProcessor::processFile(paths[i], options);
+    const double reload_ms = elapsedMs(start);
+
+    int ok = 0;
+    for (const auto& r : fresh) ok += r.ok ? 1 : 0;
+    const double n = (double)paths.size();
+    cout << "Images: " << paths.size() << ", analysed: " << ok << endl;
+    cout << fixed << setprecision(2)
+         << "Fresh analysis:  " << fresh_ms / n << " ms/image" << endl
+         << "Analyse + store: " << store_ms / n << " ms/image" << endl
+         << "Reopened hits:   " << reload_ms / n << " ms/image (" << reopened.hits() << " hits)" << endl;
+
+    int mismatches = countMismatches("reverse order", paths, fresh, reversed)
+        + countMismatches("stored", paths, fresh, stored)
+        + countMismatches("reloaded", paths, fresh, reloaded);
+    if (reopened.hits() != paths.size()) {
+        cerr << "Expected " << paths.size() << " hits after reopening, got " << reopened.hits() << endl;
+        mismatches++;
+    }
+    if (mismatches > 0) {
+        cerr << mismatches << " mismatches" << endl;
+        return 1;
+    }
+    cout << "Cached results match fresh analysis" << endl;
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "synthetic_target.h"
+
+using namespace cv;
+using namespace std;
+
+SyntheticTarget generateSyntheticTarget(const SyntheticTargetOptions& options) {
+    const double A3_WIDTH_CM = 30.0;
+    const double A3_HEIGHT_CM = 42.0;
+    const double HOLE_RADIUS_CM = 0.45;     // калибр 9 мм
+    const double GROUP_RADIUS_CM = 7.0;     // разброс пробоин вокруг центра
+    const double MIN_SPACING_CM = 2.0;      // больше радиуса объединения детектора
+
+    SyntheticTarget target;
+    RNG rng(options.seed);
+
+    int width = options.width;
+    int height = (int)round(width * A3_HEIGHT_CM / A3_WIDTH_CM);
+    double ppc = width / A3_WIDTH_CM;
+    target.pixels_per_cm = ppc;
+
+    Mat& image = target.image;
+    image.create(height, width, CV_8UC3);
+    image.setTo(Scalar(232, 236, 238));
+
+    // Черное яблочко там, где его ждет findTargetCenter
+    target.target_center = Point2f(width / 2.0f, height * 0.666f);
+    circle(image, target.target_center, (int)round(options.aim_radius_cm * ppc), Scalar(25, 25, 25), -1, LINE_AA);
+
+    // Пробоины: равномерно в круге группы, не ближе MIN_SPACING_CM друг к другу
+    int attempts = 0;
+    while ((int)target.holes.size() < options.holes && attempts++ < options.holes * 1000) {
+        double r = GROUP_RADIUS_CM * ppc * sqrt(rng.uniform(0.0, 1.0));
+        double a = rng.uniform(0.0, 2 * CV_PI);
+        Point2f p(target.target_center.x + (float)(r * cos(a)), target.target_center.y + (float)(r * sin(a)));
+
+        bool too_close = false;
+        for (const auto& h : target.holes) {
+            if (norm(h - p) < MIN_SPACING_CM * ppc) {
+                too_close = true;
+                break;
+            }
+        }
+        if (too_close) continue;
+
+        target.holes.push_back(p);
+    }
+
+    // Пробоины - красные пятна размером с калибр
+    for (const auto& h : target.holes) {
+        int radius = max(2, (int)round(HOLE_RADIUS_CM * ppc));
+        circle(image, h, radius, Scalar(30, 30, 200), -1, LINE_8);
+    }
+
+    // Конфетти: мелкие красные крошки по всему листу, часть крупнее порога площади
+    for (int i = 0; i < options.confetti; ++i) {
+        Point p(rng.uniform(0, width), rng.uniform(0, height));
+        int radius = rng.uniform(1, max(2, (int)round(0.1 * ppc)));
+        circle(image, p, radius, Scalar(rng.uniform(20, 60), rng.uniform(20, 60), rng.uniform(160, 230)), -1);
+    }
+
+    // Перепад освещенности
+    if (options.gradient > 0) {
+        vector<float> k(width);
+        for (int x = 0; x < width; ++x) k[x] = (float)(1.0 - options.gradient * x / width);
+        for (int y = 0; y < height; ++y) {
+            uchar* p = image.ptr<uchar>(y);
+            for (int x = 0; x < width; ++x, p += 3) {
+                p[0] = saturate_cast<uchar>(p[0] * k[x]);
+                p[1] = saturate_cast<uchar>(p[1] * k[x]);
+                p[2] = saturate_cast<uchar>(p[2] * k[x]);
+            }
+        }
+    }
+
+    // Шум сенсора
+    if (options.noise_sigma > 0) {
+        Mat noise(height, width, CV_16SC3), image16;
+        randn(noise, Scalar::all(0), Scalar::all(options.noise_sigma));
+        image.convertTo(image16, CV_16SC3);
+        add(image16, noise, image16);
+        image16.convertTo(image, CV_8UC3);
+    }
+
+    return target;
+}
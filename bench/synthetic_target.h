@@ -0,0 +1,28 @@
+#ifndef SYNTHETIC_TARGET_H
+#define SYNTHETIC_TARGET_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// Параметры синтетической мишени A3 (портрет, 300x420 мм)
+struct SyntheticTargetOptions {
+    int width = 3000;               // ширина снимка, пикс
+    int holes = 10;                 // количество пробоин
+    int confetti = 0;               // красные крошки и клочки бумаги
+    double noise_sigma = 8.0;       // шум сенсора
+    double gradient = 0.3;          // перепад освещенности слева направо
+    double aim_radius_cm = 5.0;     // радиус черного яблочка
+    unsigned int seed = 1;
+};
+
+// Снимок с известной разметкой
+struct SyntheticTarget {
+    cv::Mat image;
+    std::vector<cv::Point2f> holes; // истинные центры пробоин
+    cv::Point2f target_center;      // истинный центр черного яблочка
+    double pixels_per_cm = 0.0;
+};
+
+SyntheticTarget generateSyntheticTarget(const SyntheticTargetOptions& options);
+
+#endif
@@ -0,0 +1,223 @@
+// Бенчмарк этапов анализа на синтетических мишенях с известной разметкой
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <algorithm>
+#include "synthetic_target.h"
+#include "common/hole_detector.h"
+#include "common/shooting_metrics.h"
+#include "common/visualization.h"
+#include "common/analysis_context.h"
+#include "weapons/pm.h"
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+struct StageTimer {
+    int64 ticks = 0;
+    int calls = 0;
+
+    template <typename F>
+    void run(F f) {
+        int64 start = getTickCount();
+        f();
+        ticks += getTickCount() - start;
+        calls++;
+    }
+
+    double ms() const { return calls ? ticks * 1000.0 / getTickFrequency() / calls : 0.0; }
+};
+
+// Ошибка детекции относительно разметки: каждой истинной пробоине - ближайшая найденная в пределах 1 см
+struct DetectionError {
+    int matched = 0;
+    int missed = 0;
+    int false_positives = 0;
+    double mean_error_cm = 0.0;
+};
+
+DetectionError compareWithTruth(const vector<Point2f>& truth, const vector<Point2f>& found, double ppc) {
+    DetectionError e;
+    vector<bool> used(found.size(), false);
+    double sum = 0.0;
+
+    for (const auto& t : truth) {
+        int best = -1;
+        double best_dist = ppc;   // 1 см
+        for (size_t i = 0; i < found.size(); ++i) {
+            double d = norm(found[i] - t);
+            if (!used[i] && d < best_dist) {
+                best_dist = d;
+                best = (int)i;
+            }
+        }
+        if (best < 0) {
+            e.missed++;
+            continue;
+        }
+        used[best] = true;
+        e.matched++;
+        sum += best_dist / ppc;
+    }
+
+    e.false_positives = (int)count(used.begin(), used.end(), false);
+    e.mean_error_cm = e.matched ? sum / e.matched : 0.0;
+    return e;
+}
+
+// Прежний поиск центра: замыкание 9x9 и самый крупный черный объект по всему кадру
+Point2f fullFrameCenter(const Mat& image) {
+    Mat gray, binary;
+    cvtColor(image, gray, COLOR_BGR2GRAY);
+    threshold(gray, binary, 80, 255, THRESH_BINARY_INV);
+    morphologyEx(binary, binary, MORPH_CLOSE, getStructuringElement(MORPH_ELLIPSE, Size(9, 9)));
+
+    vector<vector<Point>> contours;
+    findContours(binary, contours, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
+    double max_area = 1000;
+    Point2f center(image.cols / 2.0f, image.rows * 0.666f);
+    for (const auto& contour : contours) {
+        double area = contourArea(contour);
+        if (area > max_area) {
+            max_area = area;
+            Moments m = moments(contour);
+            center = Point2f((float)(m.m10 / m.m00), (float)(m.m01 / m.m00));
+        }
+    }
+    return center;
+}
+
+// Поиск центра в окнах против прежнего прохода по кадру; same - центры совпали до 1 px
+bool runCenterCase(int width, double aim_radius_cm, int iterations) {
+    SyntheticTargetOptions options;
+    options.width = width;
+    options.aim_radius_cm = aim_radius_cm;
+    SyntheticTarget target = generateSyntheticTarget(options);
+
+    ShootingMetricsCalculator calc;
+    StageTimer t_window, t_full;
+    Point2f windowed, full;
+    for (int i = 0; i < iterations; ++i) {
+        t_window.run([&] { windowed = calc.findTargetCenter(target.image); });
+        t_full.run([&] { full = fullFrameCenter(target.image); });
+    }
+
+    const bool same = norm(windowed - full) < 1.0;
+    cout << setw(10) << (to_string(target.image.cols) + "x" + to_string(target.image.rows))
+         << setw(8) << fixed << setprecision(1) << aim_radius_cm
+         << setw(10) << setprecision(2) << t_window.ms() << setw(10) << t_full.ms()
+         << setw(9) << t_full.ms() / max(t_window.ms(), 1e-6) << setw(6) << (same ? "yes" : "NO")
+         << endl;
+    return same;
+}
+
+// false - детекция с hook_zone_first разошлась с детекцией по всему листу
+bool runCase(int width, int holes, int confetti, int iterations) {
+    SyntheticTargetOptions options;
+    options.width = width;
+    options.holes = holes;
+    options.confetti = confetti;
+    SyntheticTarget target = generateSyntheticTarget(options);
+    const Mat& image = target.image;
+
+    HoleDetector detector;
+    ShootingMetricsCalculator calc;
+    calc.setReuseLastCenter(false);
+
+    StageTimer t_clusters, t_merge, t_center, t_metrics, t_draw, t_detect, t_hook_first;
+    AnalysisContext ctx(image);
+    ctx.pixels_per_cm = detector.calculatePixelsPerCM(image);
+    double merge_px = HoleDetector::MERGE_RADIUS_CM * ctx.pixels_per_cm;
+    Point2f center;
+    Mat canvas;
+
+    // Выстрелы для метрик и отрисовки - полный проход ПМ
+    PMWeapon pm;
+    AnalysisContext full(image);
+    pm.analyze(full);
+
+    // Детекция целиком: по всему листу и сначала ниже зоны крючков (кандидаты должны совпасть)
+    AnalysisContext whole, below;
+    below.hook_zone_first = true;
+
+    for (int i = 0; i < iterations; ++i) {
+        t_detect.run([&] { whole.reset(image); detector.detectHoles(whole); });
+        t_hook_first.run([&] { below.reset(image); detector.detectHoles(below); });
+        t_clusters.run([&] { detector.findRedClusters(ctx); });
+        t_merge.run([&] { ctx.merged = detector.mergeCloseHoles(ctx.clusters, merge_px); });
+        t_center.run([&] { center = calc.findTargetCenter(image); });
+        t_metrics.run([&] { calc.calculateMetrics(full.shots, full.pixels_per_cm, &full.stp_steps); });
+
+        image.copyTo(canvas);
+        Visualization visualizer(full.pixels_per_cm);
+        t_draw.run([&] { visualizer.drawShootingResult(canvas, full); });
+    }
+
+    bool same = whole.detections.size() == below.detections.size();
+    for (size_t i = 0; same && i < whole.detections.size(); ++i) {
+        same = whole.detections[i].center == below.detections[i].center &&
+            whole.detections[i].pixel_count == below.detections[i].pixel_count;
+    }
+
+    DetectionError e = compareWithTruth(target.holes, full.shots, target.pixels_per_cm);
+    double center_error_cm = norm(center - target.target_center) / target.pixels_per_cm;
+    double total_ms = t_clusters.ms() + t_merge.ms() + t_center.ms() + t_metrics.ms() + t_draw.ms();
+    double mp = image.total() / 1e6;
+
+    cout << setw(10) << (to_string(image.cols) + "x" + to_string(image.rows))
+         << setw(6) << holes << setw(7) << confetti << fixed << setprecision(2)
+         << setw(10) << t_clusters.ms() << setw(9) << t_merge.ms() << setw(9) << t_center.ms()
+         << setw(9) << setprecision(3) << t_metrics.ms() << setw(9) << setprecision(2) << t_draw.ms()
+         << setw(9) << mp / (total_ms / 1000.0)
+         << setw(5) << e.matched << "/" << target.holes.size() << setw(5) << e.false_positives
+         << setw(8) << setprecision(3) << e.mean_error_cm << setw(8) << center_error_cm
+         << setw(9) << setprecision(2) << t_detect.ms() << setw(9) << t_hook_first.ms() << setw(6) << (same ? "yes" : "NO")
+         << endl;
+    return same;
+}
+
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 5;
+
+    const int widths[] = { 1500, 3000, 6000 };      // ~50, 100, 200 px/cm
+    const int hole_counts[] = { 4, 10 };
+    const int confetti_counts[] = { 0, 2000 };
+    int mismatches = 0;
+
+    cout << "Times in ms per call, MP/s for the sum of stages, detection error vs ground truth," << endl;
+    cout << "whole detection on the full sheet and with hook_zone_first (same - identical candidates)" << endl;
+    cout << setw(10) << "size" << setw(6) << "holes" << setw(7) << "confet"
+         << setw(10) << "clusters" << setw(9) << "merge" << setw(9) << "center"
+         << setw(9) << "metrics" << setw(9) << "draw" << setw(9) << "MP/s"
+         << setw(7) << "found" << setw(5) << "fp" << setw(8) << "err cm" << setw(8) << "ctr cm"
+         << setw(9) << "detect" << setw(9) << "hook1st" << setw(6) << "same" << endl;
+
+    for (int width : widths) {
+        for (int holes : hole_counts) {
+            for (int confetti : confetti_counts) {
+                if (!runCase(width, holes, confetti, iterations)) mismatches++;
+            }
+        }
+    }
+
+    cout << endl << "Target center search: windows around the expected point vs the former full-frame pass" << endl;
+    cout << setw(10) << "size" << setw(8) << "aim cm" << setw(10) << "windows" << setw(10) << "frame"
+         << setw(9) << "speedup" << setw(6) << "same" << endl;
+    const double aim_radii[] = { 5.0, 10.0 };
+    for (int width : widths) {
+        for (double aim_radius_cm : aim_radii) {
+            if (!runCenterCase(width, aim_radius_cm, iterations)) mismatches++;
+        }
+    }
+
+    if (mismatches > 0) {
+        cerr << mismatches << " mismatches" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+#ifndef ANALYSIS_CONTEXT_H
+#define ANALYSIS_CONTEXT_H
+
+#include <opencv2/core.hpp>
+#include <vector>
+#include "hole_detector.h"
+#include "shooting_metrics.h"
+
+class DebugArtifactSink;
+
+// Группа одной мишени на общем листе
+struct TargetGroup {
+    cv::Point2f target_center;              // центр черного круга мишени
+    std::vector<DetectedHole> detections;   // кандидаты, ближайшие к этой мишени
+    std::vector<cv::Point2f> shots;         // выстрелы группы
+    STPConstruction stp_steps;
+    ShootingMetrics metrics = ShootingMetrics();
+};
+
+// Все промежуточные данные анализа одного снимка.
+// Каждый этап считается один раз, детектор, метрики и визуализация читают отсюда.
+struct AnalysisContext {
+    cv::Mat image;                          // исходный снимок (без копирования)
+    bool coarse_to_fine = false;            // поиск на уменьшенной копии с уточнением в окнах
+    bool hook_zone_first = false;           // сначала только ниже зоны крючков, весь лист - если там не хватило
+    DebugArtifactSink* artifacts = nullptr; // отладочные изображения (nullptr - не формируются)
+
+    double preset_pixels_per_cm = 0.0;      // известный масштаб (0 - по допущению "A3 на весь кадр")
+    double pixels_per_cm = 0.0;             // масштаб
+    double area_scale = 1.0;                // площадь пикселя снимка в пикселях полного разрешения, для которого
+                                            // заданы пороги площади профиля (уменьшенный снимок: 1 / r^2)
+    int pyramid_scale = 1;                  // во сколько раз уменьшен грубый проход
+
+    cv::Mat red_mask;                       // маска красного (при pyramid_scale > 1 - грубая)
+    std::vector<DetectedHole> clusters;     // сырые красные кластеры (hook_zone_first - только просканированные)
+    std::vector<DetectedHole> merged;       // после объединения близких
+    std::vector<DetectedHole> detections;   // итоговые кандидаты детектора
+
+    std::vector<cv::Point2f> shots;         // выстрелы для расчета метрик
+    STPConstruction stp_steps;              // шаги построения СТП
+    ShootingMetrics metrics = ShootingMetrics();
+
+    std::vector<TargetGroup> targets;       // несколько мишеней на листе (analyzeTargets)
+
+    DetectionWorkspace workspace;           // буферы детектора между снимками
+
+    AnalysisContext() {}
+    explicit AnalysisContext(const cv::Mat& img) : image(img) {}
+
+    // Следующий снимок в том же контексте: результаты сбрасываются, буферы и настройки
+    // (coarse_to_fine, hook_zone_first, artifacts) остаются. В пакетном и потоковом режимах контекст - один на поток
+    void reset(const cv::Mat& img) {
+        image = img;
+        preset_pixels_per_cm = 0.0;
+        pixels_per_cm = 0.0;
+        area_scale = 1.0;
+        pyramid_scale = 1;
+        clusters.clear();
+        merged.clear();
+        detections.clear();
+        shots.clear();
+        stp_steps.clear();
+        metrics = ShootingMetrics();
+        targets.clear();
+    }
+};
+
+#endif
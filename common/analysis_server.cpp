@@ -0,0 +1,312 @@
+#include "analysis_server.h"
+#include "result_writer.h"
+#include "logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+#include <csignal>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+const size_t MAX_HEADER_BYTES = 16 << 10;
+const chrono::milliseconds STOP_POLL(200);
+
+#ifndef _WIN32
+
+typedef chrono::steady_clock::time_point Deadline;
+
+Deadline deadlineAfter(int timeout_ms) {
+    return chrono::steady_clock::now() + chrono::milliseconds(timeout_ms);
+}
+
+// Ждать готовности сокета не дольше остатка срока: клиент, присылающий по байту,
+// не продлевает соединение (SO_RCVTIMEO ограничивал бы только каждый recv)
+bool waitReady(int fd, short events, Deadline deadline) {
+    for (;;) {
+        const long long left = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+        if (left <= 0) return false;
+        pollfd pfd = { fd, events, 0 };
+        int ready = poll(&pfd, 1, (int)left);
+        if (ready > 0) return true;
+        if (ready < 0 && errno != EINTR) return false;
+    }
+}
+
+ssize_t recvBefore(int fd, void* data, size_t size, Deadline deadline) {
+    if (!waitReady(fd, POLLIN, deadline)) return -1;
+    return recv(fd, data, size, 0);
+}
+
+bool sendAll(int fd, const string& data, Deadline deadline) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        if (!waitReady(fd, POLLOUT, deadline)) return false;
+        // Без ожидания: блокирующий send большого ответа ждал бы медленного клиента мимо срока
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_DONTWAIT);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) continue;
+        if (n <= 0) return false;
+        sent += (size_t)n;
+    }
+    return true;
+}
+
+bool recvAll(int fd, unsigned char* data, size_t size, Deadline deadline) {
+    size_t received = 0;
+    while (received < size) {
+        ssize_t n = recvBefore(fd, data + received, size - received, deadline);
+        if (n <= 0) return false;
+        received += (size_t)n;
+    }
+    return true;
+}
+
+// Конец заголовка - пустая строка ("\n\n" или "\r\n\r\n"); body_start - первый байт после нее
+bool findHeaderEnd(const string& header, size_t& header_end, size_t& body_start) {
+    size_t lf = header.find("\n\n");
+    size_t crlf = header.find("\r\n\r\n");
+    if (lf == string::npos && crlf == string::npos) return false;
+    if (crlf != string::npos && (lf == string::npos || crlf < lf)) {
+        header_end = crlf;
+        body_start = crlf + 4;
+    } else {
+        header_end = lf;
+        body_start = lf + 2;
+    }
+    return true;
+}
+
+#endif
+
+struct Request {
+    string path;
+    long long data_size = -1;
+    string lane;
+    string weapon;
+    bool has_lane = false;
+};
+
+bool parseRequest(const string& header, Request& request, string& error) {
+    size_t pos = 0;
+    while (pos < header.size()) {
+        size_t end = header.find('\n', pos);
+        if (end == string::npos) end = header.size();
+        string line = header.substr(pos, end - pos);
+        pos = end + 1;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+
+        size_t space = line.find(' ');
+        const string key = line.substr(0, space);
+        const string value = space == string::npos ? "" : line.substr(space + 1);
+        if (key == "path") request.path = value;
+        else if (key == "data") request.data_size = atoll(value.c_str());
+        else if (key == "lane") {
+            request.lane = value;
+            request.has_lane = true;
+        } else if (key == "weapon") request.weapon = value;
+        else {
+            error = "unknown request field " + key;
+            return false;
+        }
+    }
+    if (request.path.empty() == (request.data_size < 0)) {
+        error = "request needs exactly one of path or data";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+AnalysisServer::~AnalysisServer() {
+    stop_ = true;
+    shutdown();
+}
+
+#ifdef _WIN32
+
+bool AnalysisServer::start(const ServerOptions&, string* error) {
+    if (error) *error = "daemon mode needs UNIX domain sockets";
+    return false;
+}
+
+void AnalysisServer::run() {}
+
+void AnalysisServer::workerLoop() {}
+
+void AnalysisServer::serve(int) {}
+
+void AnalysisServer::shutdown() {}
+
+#else
+
+bool AnalysisServer::start(const ServerOptions& options, string* error) {
+    options_ = options;
+    if (options_.workers <= 0) options_.workers = max(1, (int)thread::hardware_concurrency());
+    if (options_.queue_capacity == 0) options_.queue_capacity = 2 * (size_t)options_.workers;
+
+    // Клиент, закрывший соединение раньше ответа, не должен ронять процесс
+    signal(SIGPIPE, SIG_IGN);
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (options_.socket_path.empty() || options_.socket_path.size() >= sizeof(addr.sun_path)) {
+        if (error) *error = "bad socket path " + options_.socket_path;
+        return false;
+    }
+    memcpy(addr.sun_path, options_.socket_path.c_str(), options_.socket_path.size());
+
+    // Сокет от прошлого запуска заменяется, обычный файл - нет
+    struct stat st;
+    if (lstat(options_.socket_path.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            if (error) *error = options_.socket_path + " exists and is not a socket";
+            return false;
+        }
+        unlink(options_.socket_path.c_str());
+    }
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd_ < 0 || bind(listen_fd_, (const sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(listen_fd_, (int)options_.queue_capacity) != 0) {
+        if (error) *error = string("cannot listen on ") + options_.socket_path + ": " + strerror(errno);
+        if (listen_fd_ >= 0) ::close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+
+    closing_ = false;
+    stop_ = false;
+    for (int i = 0; i < options_.workers; ++i) workers_.emplace_back(&AnalysisServer::workerLoop, this);
+    TL_LOG_INFO("Listening on " << options_.socket_path << ", " << options_.workers << " workers, queue "
+        << options_.queue_capacity);
+    return true;
+}
+
+void AnalysisServer::run() {
+    while (!stop_) {
+        // Очередь полна - новые соединения не принимаются и ждут в очереди ядра
+        {
+            unique_lock<mutex> guard(lock_);
+            not_full_.wait_for(guard, STOP_POLL, [&] { return pending_.size() < options_.queue_capacity || stop_; });
+            if (pending_.size() >= options_.queue_capacity) continue;
+        }
+
+        pollfd p;
+        p.fd = listen_fd_;
+        p.events = POLLIN;
+        p.revents = 0;
+        if (poll(&p, 1, (int)STOP_POLL.count()) <= 0) continue;
+
+        int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) continue;
+
+        lock_guard<mutex> guard(lock_);
+        pending_.push_back(fd);
+        not_empty_.notify_one();
+    }
+    shutdown();
+}
+
+void AnalysisServer::workerLoop() {
+    for (;;) {
+        int fd;
+        {
+            unique_lock<mutex> guard(lock_);
+            not_empty_.wait(guard, [&] { return closing_ || !pending_.empty(); });
+            // При остановке принятые соединения дообслуживаются
+            if (pending_.empty()) break;
+            fd = pending_.front();
+            pending_.pop_front();
+        }
+        not_full_.notify_one();
+
+        serve(fd);
+        ::close(fd);
+    }
+}
+
+void AnalysisServer::serve(int fd) {
+    // Один срок на весь запрос - заголовок и тело
+    const Deadline request_deadline = deadlineAfter(options_.io_timeout_ms);
+    const size_t index = served_++;
+
+    // Снимок data читается в буфер потока: между запросами память не освобождается
+    thread_local vector<unsigned char> body;
+    thread_local string header;
+    header.clear();
+
+    size_t header_end = 0, body_start = 0;
+    char chunk[4096];
+    while (!findHeaderEnd(header, header_end, body_start)) {
+        if (header.size() > MAX_HEADER_BYTES) return;
+        ssize_t n = recvBefore(fd, chunk, sizeof(chunk), request_deadline);
+        if (n <= 0) return;
+        header.append(chunk, (size_t)n);
+    }
+
+    BatchItemResult result;
+    Request request;
+    if (!parseRequest(header.substr(0, header_end), request, result.error)) {
+        result.path = "-";
+        sendAll(fd, ResultWriter::formatRecord(ResultFormat::JsonLines, index, result), deadlineAfter(options_.io_timeout_ms));
+        return;
+    }
+
+    BatchOptions options = options_.analysis;
+    if (!request.weapon.empty()) options.weapon = request.weapon;
+    if (request.has_lane && options_.calibration) {
+        options.calibration = options_.calibration;
+        options.lane = request.lane;
+    }
+
+    if (!request.path.empty()) {
+        result = BatchProcessor::processFile(request.path, options);
+    } else if ((unsigned long long)request.data_size > options_.max_inline_bytes) {
+        result.path = "-";
+        result.error = "image larger than " + to_string(options_.max_inline_bytes) + " bytes";
+    } else {
+        const size_t size = (size_t)request.data_size;
+        const size_t prefix = min(size, header.size() - body_start);
+        body.resize(size);
+        memcpy(body.data(), header.data() + body_start, prefix);
+        if (!recvAll(fd, body.data() + prefix, size - prefix, request_deadline)) return;
+        result = BatchProcessor::processBuffer(body.data(), size, options);
+    }
+
+    sendAll(fd, ResultWriter::formatRecord(ResultFormat::JsonLines, index, result), deadlineAfter(options_.io_timeout_ms));
+}
+
+void AnalysisServer::shutdown() {
+    if (listen_fd_ < 0 && workers_.empty()) return;
+
+    if (listen_fd_ >= 0) {
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        unlink(options_.socket_path.c_str());
+    }
+    {
+        lock_guard<mutex> guard(lock_);
+        closing_ = true;
+    }
+    not_empty_.notify_all();
+    for (auto& worker : workers_) worker.join();
+    workers_.clear();
+    Logger::flushAll();
+}
+
+#endif
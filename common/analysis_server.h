@@ -0,0 +1,71 @@
+#ifndef ANALYSIS_SERVER_H
+#define ANALYSIS_SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "batch_processor.h"
+
+// Резидентный режим: запросы через UNIX-сокет, один запрос на соединение.
+//
+// Запрос - строки "ключ значение", пустая строка, затем (для data) сам снимок:
+//   path /lanes/3/0001.jpg      снимок из файла
+//   data 183204                 или закодированный снимок такой длины сразу после заголовка
+//   lane 3                      необязательно: калибровка линии (CalibrationCache сервера)
+//   weapon ak                   необязательно: профиль упражнения
+// Ответ - одна JSON-строка в формате --out jsonl (ResultWriter), index - номер запроса с запуска.
+//
+// Соединения обслуживает фиксированный пул потоков. Ожидающих соединений не больше queue_capacity:
+// при заполненной очереди сервер перестает принимать, и клиенты ждут в очереди ядра.
+// Потоки пула живут весь сеанс, поэтому модули оружия, буферы и калибровки остаются прогретыми.
+struct ServerOptions {
+    std::string socket_path;
+    int workers = 0;                        // <= 0 - по числу ядер
+    size_t queue_capacity = 0;              // 0 - 2 * workers
+    size_t max_inline_bytes = 64 << 20;     // предел снимка data
+    int io_timeout_ms = 5000;               // на чтение всего запроса и отдельно на отправку ответа
+    BatchOptions analysis;                  // параметры анализа по умолчанию
+    CalibrationCache* calibration = nullptr; // для запросов с lane
+};
+
+class AnalysisServer {
+public:
+    AnalysisServer() {}
+    ~AnalysisServer();
+
+    // Создает сокет (существующий файл сокета заменяется) и запускает пул
+    bool start(const ServerOptions& options, std::string* error = nullptr);
+
+    // Прием соединений в вызывающем потоке до stop(); затем дожидается пула и удаляет сокет
+    void run();
+
+    // Только выставляет флаг: можно вызывать из обработчика сигнала
+    void stop() { stop_ = true; }
+
+    size_t served() const { return served_; }
+
+    AnalysisServer(const AnalysisServer&) = delete;
+    AnalysisServer& operator=(const AnalysisServer&) = delete;
+
+private:
+    void workerLoop();
+    void serve(int fd);
+    void shutdown();
+
+    ServerOptions options_;
+    int listen_fd_ = -1;
+    std::vector<std::thread> workers_;
+    std::deque<int> pending_;
+    bool closing_ = false;
+    std::mutex lock_;
+    std::condition_variable not_empty_, not_full_;
+    std::atomic<bool> stop_{ false };
+    std::atomic<size_t> served_{ 0 };
+};
+
+#endif
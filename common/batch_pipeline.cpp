@@ -0,0 +1,265 @@
+#include "batch_pipeline.h"
+#include <opencv2/imgcodecs.hpp>
+#include "analysis_context.h"
+#include "content_hash.h"
+#include "image_ingest.h"
+#include "result_cache.h"
+#include "visualization.h"
+#include "result_writer.h"
+#include "profiler.h"
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+// Ожидание на пустой или полной очереди: сначала уступить процессор, потом спать
+class Backoff {
+public:
+    void pause() {
+        if (++spins_ < 64) this_thread::yield();
+        else this_thread::sleep_for(chrono::microseconds(100));
+    }
+    void reset() { spins_ = 0; }
+
+private:
+    int spins_ = 0;
+};
+
+template <typename T>
+void pushWait(BoundedQueue<T>& queue, const T& value) {
+    Backoff backoff;
+    while (!queue.tryPush(value)) backoff.pause();
+}
+
+template <typename T>
+T popWait(BoundedQueue<T>& queue) {
+    Backoff backoff;
+    T value;
+    while (!queue.tryPop(value)) backoff.pause();
+    return value;
+}
+
+bool makeDirectory(const string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0) return (st.st_mode & S_IFDIR) != 0;
+#ifdef _WIN32
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+    return stat(path.c_str(), &st) == 0 && (st.st_mode & S_IFDIR) != 0;
+}
+
+// Имя размеченного снимка: <каталог>/<имя без расширения>_result.jpg
+string renderPath(const string& directory, const string& path) {
+    size_t slash = path.find_last_of("/\\");
+    string name = slash == string::npos ? path : path.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    if (dot != string::npos) name.erase(dot);
+    return directory + "/" + name + "_result.jpg";
+}
+
+}
+
+// Рабочий элемент: снимок и все буферы его обработки
+struct BatchPipeline::Item {
+    size_t index = 0;
+    IngestedImage ingested;
+    Mat rectified;
+    AnalysisContext ctx;
+    BatchItemResult result;
+    Mat canvas;
+    vector<uchar> encoded;
+
+    // Ключ кэша результатов, если он используется
+    FileStamp stamp;
+    uint64_t content = 0;
+};
+
+BatchPipeline::BatchPipeline(const BatchOptions& options, const PipelineOptions& pipeline)
+    : options_(options), pipeline_(pipeline) {}
+
+BatchPipeline::~BatchPipeline() {}
+
+vector<BatchItemResult> BatchPipeline::run(const vector<string>& paths) {
+    vector<BatchItemResult> results(paths.size());
+    if (paths.empty()) return results;
+
+    const int cores = max(1, (int)thread::hardware_concurrency());
+    if (!pipeline_.render_dir.empty() && !makeDirectory(pipeline_.render_dir)) {
+        TL_LOG_ERROR("Cannot create " << pipeline_.render_dir << ", annotated images are not written");
+        pipeline_.render_dir.clear();
+    }
+    const bool render = !pipeline_.render_dir.empty();
+    const int decoders = pipeline_.decode_threads > 0 ? pipeline_.decode_threads : max(1, cores / 4);
+    const int renderers = !render ? 0 : pipeline_.render_threads > 0 ? pipeline_.render_threads : max(1, cores / 4);
+    int detectors = pipeline_.detect_threads > 0 ? pipeline_.detect_threads : options_.num_threads;
+    if (detectors <= 0) detectors = max(1, cores - decoders - renderers);
+
+    const size_t in_flight = pipeline_.in_flight > 0 ? pipeline_.in_flight
+        : 2 * (size_t)(decoders + detectors + renderers);
+
+    // Очереди вмещают все элементы: push в них не ждет, ждут только pop и захват свободного элемента
+    paths_ = &paths;
+    results_ = &results;
+    if (items_.size() != in_flight) {
+        items_.clear();
+        for (size_t i = 0; i < in_flight; ++i) items_.emplace_back(new Item());
+    }
+    free_.reset(new BoundedQueue<Item*>(in_flight));
+    decoded_.reset(new BoundedQueue<Item*>(in_flight));
+    analyzed_.reset(new BoundedQueue<Item*>(in_flight));
+    for (auto& item : items_) free_->tryPush(item.get());
+
+    next_index_ = 0;
+    decoders_left_ = decoders;
+    detectors_left_ = detectors;
+    TL_LOG_INFO("Pipeline: " << decoders << " decode, " << detectors << " detect, " << renderers
+        << " render threads, " << in_flight << " images in flight");
+
+    // Параллелизм - только потоками стадий, вызовы OpenCV внутри стадий последовательны
+    const int prev_threads = getNumThreads();
+    setNumThreads(1);
+
+    vector<thread> threads;
+    for (int i = 0; i < decoders; ++i) threads.emplace_back(&BatchPipeline::decodeLoop, this);
+    for (int i = 0; i < detectors; ++i) threads.emplace_back(&BatchPipeline::detectLoop, this);
+    for (int i = 0; i < renderers; ++i) threads.emplace_back(&BatchPipeline::renderLoop, this);
+    for (auto& t : threads) t.join();
+
+    Logger::flushAll();
+    setNumThreads(prev_threads);
+    paths_ = nullptr;
+    results_ = nullptr;
+    return results;
+}
+
+void BatchPipeline::decodeLoop() {
+    IngestOptions ingest_options;
+    ingest_options.target_pixels_per_cm = options_.target_pixels_per_cm;
+
+    // С отрисовкой снимок декодируется всегда: кэш только пополняется, но не подменяет анализ
+    ResultCache* cache = options_.calibration ? nullptr : options_.cache;
+    const bool render = !pipeline_.render_dir.empty();
+    const uint64_t params = cache ? analysisParameterHash(options_) : 0;
+    MappedFile file;
+
+    for (;;) {
+        const size_t index = next_index_++;
+        if (index >= paths_->size()) break;
+
+        Item* item = popWait(*free_);
+        item->index = index;
+        item->result = BatchItemResult();
+        item->result.path = (*paths_)[index];
+
+        if (!cache) {
+            if (ingestImage(item->result.path, ingest_options, item->ingested, &item->result.error)) {
+                pushWait(*decoded_, item);
+            } else {
+                finish(item);
+            }
+            continue;
+        }
+
+        // Попадание в кэш завершает снимок прямо здесь, минуя детекцию
+        if (!render && cache->lookupFile(item->result.path, params, item->result, item->stamp)) {
+            finish(item);
+            continue;
+        }
+        if (render) statFile(item->result.path, item->stamp);
+        if (!file.open(item->result.path)) {
+            item->result.error = "cannot open image";
+            finish(item);
+            continue;
+        }
+        item->content = hashBytes(file.data(), file.size());
+        if (!render && cache->lookup(item->stamp, item->content, params, item->result)) {
+            file.close();
+            finish(item);
+            continue;
+        }
+        const bool decoded = ingestBuffer(file.data(), file.size(), ingest_options, item->ingested,
+            &item->result.error);
+        file.close();
+        if (decoded) pushWait(*decoded_, item);
+        else finish(item);
+    }
+    decoders_left_--;
+}
+
+void BatchPipeline::detectLoop() {
+    const bool render = !pipeline_.render_dir.empty();
+    ResultCache* cache = options_.calibration ? nullptr : options_.cache;
+    const uint64_t params = cache ? analysisParameterHash(options_) : 0;
+    Backoff backoff;
+    for (;;) {
+        Item* item;
+        if (!decoded_->tryPop(item)) {
+            // Декодеры закончили - проверить очередь еще раз: элемент мог попасть в нее перед этим
+            if (decoders_left_ > 0) {
+                backoff.pause();
+                continue;
+            }
+            if (!decoded_->tryPop(item)) break;
+        }
+        backoff.reset();
+
+        BatchProcessor::analyzeImage(item->ingested, options_, item->ctx, item->rectified, item->result);
+        if (cache) cache->store(item->stamp, item->content, params, item->result);
+        if (render && item->result.ok) pushWait(*analyzed_, item);
+        else finish(item);
+    }
+    detectors_left_--;
+}
+
+void BatchPipeline::renderLoop() {
+    vector<int> params = { IMWRITE_JPEG_QUALITY, pipeline_.jpeg_quality };
+    Backoff backoff;
+    for (;;) {
+        Item* item;
+        if (!analyzed_->tryPop(item)) {
+            if (detectors_left_ > 0) {
+                backoff.pause();
+                continue;
+            }
+            if (!analyzed_->tryPop(item)) break;
+        }
+        backoff.reset();
+
+        // Холст и буфер JPEG элемента переиспользуются
+        const AnalysisContext& ctx = item->ctx;
+        ctx.image.copyTo(item->canvas);
+        Visualization(ctx.pixels_per_cm).drawShootingResult(item->canvas, ctx);
+        {
+            TL_PROFILE_SCOPE("encode");
+            imencode(".jpg", item->canvas, item->encoded, params);
+        }
+
+        const string path = renderPath(pipeline_.render_dir, item->result.path);
+        ofstream out(path, ios::binary);
+        if (!out.write(reinterpret_cast<const char*>(item->encoded.data()), (streamsize)item->encoded.size())) {
+            TL_LOG_WARNING("Cannot write " << path);
+        }
+        finish(item);
+    }
+}
+
+void BatchPipeline::finish(Item* item) {
+    BatchItemResult& result = (*results_)[item->index];
+    result = item->result;
+    if (options_.writer) options_.writer->write(item->index, result);
+    pushWait(*free_, item);
+}
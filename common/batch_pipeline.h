@@ -0,0 +1,57 @@
+#ifndef BATCH_PIPELINE_H
+#define BATCH_PIPELINE_H
+
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "batch_processor.h"
+#include "bounded_queue.h"
+
+// Пакетная обработка конвейером: чтение и декодирование -> детекция и метрики -> отрисовка и кодирование.
+// У каждой стадии свои потоки, между стадиями - ограниченные очереди без блокировок (BoundedQueue).
+// Снимки идут в рабочих элементах фиксированного пула: элементов не больше in_flight,
+// их буферы (снимок, контекст детектора, холст, JPEG) переиспользуются.
+// Пропускная способность определяется самой медленной стадией, а не суммой стадий.
+struct PipelineOptions {
+    int decode_threads = 0;         // <= 0 - четверть ядер, не меньше 1
+    int detect_threads = 0;         // <= 0 - остальные ядра (BatchOptions::num_threads, если задано)
+    int render_threads = 0;         // <= 0 - четверть ядер, не меньше 1; только с render_dir
+    size_t in_flight = 0;           // 0 - 2 * (число всех потоков)
+    std::string render_dir;         // каталог размеченных снимков; пусто - без отрисовки и кодирования
+    int jpeg_quality = 90;
+};
+
+class BatchPipeline {
+public:
+    BatchPipeline(const BatchOptions& options, const PipelineOptions& pipeline);
+    ~BatchPipeline();
+
+    // Результаты - в порядке входного списка; writer из BatchOptions получает их по мере готовности
+    std::vector<BatchItemResult> run(const std::vector<std::string>& paths);
+
+    BatchPipeline(const BatchPipeline&) = delete;
+    BatchPipeline& operator=(const BatchPipeline&) = delete;
+
+private:
+    struct Item;
+
+    void decodeLoop();
+    void detectLoop();
+    void renderLoop();
+    void finish(Item* item);
+
+    BatchOptions options_;
+    PipelineOptions pipeline_;
+
+    // Состояние одного запуска run()
+    const std::vector<std::string>* paths_ = nullptr;
+    std::vector<BatchItemResult>* results_ = nullptr;
+    std::vector<std::unique_ptr<Item>> items_;
+    std::unique_ptr<BoundedQueue<Item*>> free_, decoded_, analyzed_;
+    std::atomic<size_t> next_index_{ 0 };
+    std::atomic<int> decoders_left_{ 0 }, detectors_left_{ 0 };
+};
+
+#endif
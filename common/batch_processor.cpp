@@ -0,0 +1,219 @@
+#include "batch_processor.h"
+#include "content_hash.h"
+#include "image_ingest.h"
+#include "logger.h"
+#include "result_cache.h"
+#include "result_writer.h"
+#include "sheet_calibration.h"
+#include "../weapons/weapon_registry.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+bool isDirectory(const string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    return (st.st_mode & S_IFDIR) != 0;
+}
+
+string lowerExtension(const string& path) {
+    size_t dot = path.find_last_of('.');
+    if (dot == string::npos) return "";
+    string ext = path.substr(dot + 1);
+    transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)tolower(c); });
+    return ext;
+}
+
+bool isImageFile(const string& path) {
+    const string ext = lowerExtension(path);
+    return ext == "jpg" || ext == "jpeg" || ext == "png" || ext == "bmp" || ext == "tif" || ext == "tiff";
+}
+
+void analyzeIngested(const IngestedImage& ingested, const BatchOptions& options, BatchItemResult& result) {
+    // Контекст на поток: буферы детектора переходят от снимка к снимку
+    thread_local AnalysisContext ctx;
+    thread_local Mat rectified;
+    BatchProcessor::analyzeImage(ingested, options, ctx, rectified, result);
+}
+
+// С кэшем: сначала по stat файла без чтения, затем по хешу содержимого, и только потом декодирование
+void processFileCached(ResultCache& cache, const BatchOptions& options, BatchItemResult& result) {
+    const uint64_t params = analysisParameterHash(options);
+    FileStamp stamp;
+    if (cache.lookupFile(result.path, params, result, stamp)) return;
+
+    MappedFile file;
+    if (!file.open(result.path)) {
+        result.error = "cannot open image";
+        return;
+    }
+    const uint64_t content = hashBytes(file.data(), file.size());
+    if (cache.lookup(stamp, content, params, result)) return;
+
+    IngestOptions ingest_options;
+    ingest_options.target_pixels_per_cm = options.target_pixels_per_cm;
+    thread_local IngestedImage ingested;
+    if (!ingestBuffer(file.data(), file.size(), ingest_options, ingested, &result.error)) return;
+    analyzeIngested(ingested, options, result);
+    cache.store(stamp, content, params, result);
+}
+
+// Каждый поток обрабатывает свою часть снимков целиком
+class BatchBody : public ParallelLoopBody {
+public:
+    BatchBody(const vector<string>& paths, vector<BatchItemResult>& results, const BatchOptions& options)
+        : paths_(paths), results_(results), options_(options) {}
+
+    void operator()(const Range& range) const override {
+        for (int i = range.start; i < range.end; ++i) {
+            results_[i] = BatchProcessor::processFile(paths_[i], options_);
+            if (options_.writer) options_.writer->write((size_t)i, results_[i]);
+        }
+    }
+
+private:
+    const vector<string>& paths_;
+    vector<BatchItemResult>& results_;
+    const BatchOptions& options_;
+};
+
+}
+
+BatchProcessor::BatchProcessor(const BatchOptions& options) : options_(options) {}
+
+void BatchProcessor::analyzeImage(const IngestedImage& ingested, const BatchOptions& options, AnalysisContext& ctx,
+    Mat& rectified, BatchItemResult& result) {
+    result.decode_reduction = ingested.reduction;
+
+    // Снимки одной линии выпрямляются общей калибровкой, считанной по первому
+    Mat image = ingested.image;
+    if (options.calibration) {
+        options.calibration->rectify(options.lane, image, rectified);
+        image = rectified;
+    }
+
+    // Один экземпляр на поток ради буферов. Центр мишени ищется на каждом снимке заново: снимки
+    // попадают в поток в произвольном порядке, и результат не должен зависеть от соседей
+    thread_local unique_ptr<Weapon> weapon;
+    if (!weapon || options.weapon != weapon->name()) weapon = createWeapon(options.weapon);
+    if (!weapon) {
+        result.error = "unknown weapon " + options.weapon;
+        return;
+    }
+    // Явно, а не по умолчанию: от этого зависит кэш результатов - ключ в нем только снимок и параметры
+    weapon->setReuseLastCenter(false);
+
+    ctx.reset(image);
+    ctx.coarse_to_fine = options.coarse_to_fine;
+    ctx.hook_zone_first = options.hook_zone_first;
+
+    // Снимок, уменьшенный при декодировании: пороги площади профиля - в пикселях полного разрешения.
+    // Выпрямленный лист имеет свой масштаб и от уменьшения не зависит
+    if (!options.calibration) ctx.area_scale = 1.0 / ((double)ingested.reduction * ingested.reduction);
+    if (options.sheets_across > 1) {
+        ctx.preset_pixels_per_cm = HoleDetectorBase::sheetsPixelsPerCM(image.size(), options.sheets_across);
+    }
+    weapon->analyze(ctx);
+
+    result.pixels_per_cm = ctx.pixels_per_cm;
+    result.detections = ctx.detections;
+    if (ctx.shots.empty()) {
+        result.error = "no holes detected";
+        return;
+    }
+
+    result.holes = ctx.shots;
+    result.metrics = ctx.metrics;
+    result.ok = true;
+}
+
+BatchItemResult BatchProcessor::processFile(const string& path, const BatchOptions& options) {
+    BatchItemResult result;
+    result.path = path;
+
+    // Результат с калибровкой зависит от снимка, по которому калибровалась линия, и не кэшируется
+    if (options.cache && !options.calibration) {
+        processFileCached(*options.cache, options, result);
+        return result;
+    }
+
+    // Файл отображается в память и декодируется сразу в нужном масштабе
+    IngestOptions ingest_options;
+    ingest_options.target_pixels_per_cm = options.target_pixels_per_cm;
+    thread_local IngestedImage ingested;
+    if (ingestImage(path, ingest_options, ingested, &result.error)) {
+        analyzeIngested(ingested, options, result);
+    }
+    return result;
+}
+
+BatchItemResult BatchProcessor::processBuffer(const unsigned char* data, size_t size, const BatchOptions& options) {
+    BatchItemResult result;
+    result.path = "-";
+
+    IngestOptions ingest_options;
+    ingest_options.target_pixels_per_cm = options.target_pixels_per_cm;
+    ResultCache* cache = options.calibration ? nullptr : options.cache;
+    const uint64_t params = cache ? analysisParameterHash(options) : 0;
+    const uint64_t content = cache ? hashBytes(data, size) : 0;
+    if (cache && cache->lookup(FileStamp(), content, params, result)) return result;
+
+    thread_local IngestedImage ingested;
+    if (ingestBuffer(data, size, ingest_options, ingested, &result.error)) {
+        analyzeIngested(ingested, options, result);
+        if (cache) cache->store(FileStamp(), content, params, result);
+    }
+    return result;
+}
+
+vector<string> BatchProcessor::collectInputs(const string& source) {
+    vector<string> paths;
+
+    if (isDirectory(source)) {
+        vector<String> files;
+        glob(source + "/*", files, false);
+        for (const auto& f : files) {
+            if (isImageFile(f)) paths.push_back(f);
+        }
+        sort(paths.begin(), paths.end());
+        return paths;
+    }
+
+    if (isImageFile(source)) {
+        paths.push_back(source);
+        return paths;
+    }
+
+    // Текстовый список: один путь на строку, # - комментарий
+    ifstream list(source);
+    string line;
+    while (getline(list, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        paths.push_back(line);
+    }
+    return paths;
+}
+
+vector<BatchItemResult> BatchProcessor::run(const vector<string>& paths) {
+    vector<BatchItemResult> results(paths.size());
+    if (paths.empty()) return results;
+
+    int prev_threads = getNumThreads();
+    if (options_.num_threads > 0) setNumThreads(options_.num_threads);
+
+    // Один снимок - одна задача; вложенные вызовы OpenCV внутри потока выполняются последовательно
+    parallel_for_(Range(0, (int)paths.size()), BatchBody(paths, results, options_),
+        (double)paths.size());
+    Logger::flushAll();
+
+    setNumThreads(prev_threads);
+    return results;
+}
@@ -0,0 +1,65 @@
+#ifndef BATCH_PROCESSOR_H
+#define BATCH_PROCESSOR_H
+
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+#include "hole_detector.h"
+#include "shooting_metrics.h"
+
+class ResultWriter;
+class CalibrationCache;
+class ResultCache;
+struct IngestedImage;
+struct AnalysisContext;
+
+// Результат обработки одного снимка в пакетном режиме
+struct BatchItemResult {
+    std::string path;
+    bool ok = false;
+    std::string error;
+    std::vector<cv::Point2f> holes;
+    std::vector<DetectedHole> detections;   // итоговые кандидаты детектора
+    ShootingMetrics metrics = ShootingMetrics();
+    double pixels_per_cm = 0.0;
+    int decode_reduction = 1;       // координаты - в пикселях уменьшенного при декодировании снимка
+};
+
+struct BatchOptions {
+    int num_threads = 0;                    // <= 0 - использовать все ядра
+    bool coarse_to_fine = false;            // пирамидальная детекция
+    bool hook_zone_first = false;           // сначала только ниже зоны крючков (AnalysisContext)
+    double target_pixels_per_cm = 0.0;      // уменьшение JPEG при декодировании, 0 - полное разрешение
+    int sheets_across = 1;                  // листов A3 рядом в кадре (масштаб)
+    std::string weapon = "pm";              // профиль упражнения (weapon_registry.h)
+    CalibrationCache* calibration = nullptr; // выпрямление по калибровке линии lane (nullptr - без него)
+    std::string lane;
+    ResultWriter* writer = nullptr;         // запись результатов по мере готовности (из потоков пула)
+    ResultCache* cache = nullptr;           // кэш результатов повторных прогонов (не используется с calibration)
+};
+
+class BatchProcessor {
+public:
+    explicit BatchProcessor(const BatchOptions& options = BatchOptions());
+
+    // Каталог, текстовый список путей или одиночный файл
+    static std::vector<std::string> collectInputs(const std::string& source);
+
+    // Результаты возвращаются в порядке входного списка
+    std::vector<BatchItemResult> run(const std::vector<std::string>& paths);
+
+    // Один снимок в вызывающем потоке: файл или закодированный снимок в памяти (path = "-").
+    // Модуль оружия - свой на каждый поток и переиспользуется между вызовами
+    static BatchItemResult processFile(const std::string& path, const BatchOptions& options);
+    static BatchItemResult processBuffer(const unsigned char* data, size_t size, const BatchOptions& options);
+
+    // Анализ декодированного снимка в переданных контексте и буфере выпрямления (для конвейера,
+    // где снимок после анализа уходит на отрисовку): ctx.image ссылается на ingested.image или rectified
+    static void analyzeImage(const IngestedImage& ingested, const BatchOptions& options, AnalysisContext& ctx,
+        cv::Mat& rectified, BatchItemResult& result);
+
+private:
+    BatchOptions options_;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// Ограниченная очередь без блокировок для нескольких писателей и читателей (схема Вьюкова):
+// кольцевой буфер, у каждой ячейки - счетчик последовательности, позиции захватываются CAS.
+// Емкость округляется вверх до степени двойки. tryPush/tryPop не ждут: при полной или пустой
+// очереди возвращают false, ожидание - на стороне вызывающего
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size *= 2;
+        cells_.reset(new Cell[size]);
+        mask_ = size - 1;
+        for (size_t i = 0; i < size; ++i) cells_[i].sequence.store(i, std::memory_order_relaxed);
+        enqueue_.value.store(0, std::memory_order_relaxed);
+        dequeue_.value.store(0, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+    bool tryPush(const T& value) {
+        size_t pos = enqueue_.value.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t diff = (std::ptrdiff_t)sequence - (std::ptrdiff_t)pos;
+            if (diff == 0) {
+                if (enqueue_.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;   // полна
+            } else {
+                pos = enqueue_.value.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T& value) {
+        size_t pos = dequeue_.value.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t diff = (std::ptrdiff_t)sequence - (std::ptrdiff_t)(pos + 1);
+            if (diff == 0) {
+                if (dequeue_.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = cell.value;
+                    cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;   // пуста
+            } else {
+                pos = dequeue_.value.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    // Счетчик с отступом до конца строки кэша: позиции писателей и читателей не делят строку.
+    // Отступ вместо alignas: до C++17 new не выравнивает объекты сильнее стандартного
+    static const size_t CACHE_LINE = 64;
+    struct Position {
+        std::atomic<size_t> value;
+        char pad[CACHE_LINE - sizeof(std::atomic<size_t>)];
+    };
+
+    Position enqueue_;
+    Position dequeue_;
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_ = 0;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef CONTENT_HASH_H
+#define CONTENT_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Некриптографический 64-битный хеш XXH64: четыре независимые полосы по 8 байт,
+// несколько ГБ/с на ядро - хеш снимка заметно дешевле его декодирования.
+// Для ключей кэша: случайное совпадение двух разных снимков - порядка 2^-64 на пару.
+
+namespace content_hash_detail {
+
+const uint64_t P1 = 11400714785074694791ULL;
+const uint64_t P2 = 14029467366897019727ULL;
+const uint64_t P3 = 1609587929392839161ULL;
+const uint64_t P4 = 9650029242287828579ULL;
+const uint64_t P5 = 2870177450012600261ULL;
+
+inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint64_t read64(const unsigned char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t read32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t mixLane(uint64_t acc, uint64_t input) {
+    acc += input * P2;
+    return rotl(acc, 31) * P1;
+}
+
+inline uint64_t mergeRound(uint64_t acc, uint64_t value) {
+    acc ^= mixLane(0, value);
+    return acc * P1 + P4;
+}
+
+}
+
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0) {
+    using namespace content_hash_detail;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    uint64_t h;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + P1 + P2, v2 = seed + P2, v3 = seed, v4 = seed - P1;
+        const unsigned char* limit = end - 32;
+        do {
+            v1 = mixLane(v1, read64(p));
+            v2 = mixLane(v2, read64(p + 8));
+            v3 = mixLane(v3, read64(p + 16));
+            v4 = mixLane(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    } else {
+        h = seed + P5;
+    }
+    h += (uint64_t)size;
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= mixLane(0, read64(p));
+        h = rotl(h, 27) * P1 + P4;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t)read32(p) * P1;
+        h = rotl(h, 23) * P2 + P3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= (uint64_t)*p * P5;
+        h = rotl(h, 11) * P1;
+    }
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+// Отпечаток набора параметров: значения хешируются цепочкой в порядке добавления
+class ParameterHasher {
+public:
+    ParameterHasher& add(double value) { return addBytes(&value, sizeof(value)); }
+    ParameterHasher& add(int64_t value) { return addBytes(&value, sizeof(value)); }
+    ParameterHasher& add(int value) { return add((int64_t)value); }
+    ParameterHasher& add(bool value) { return add((int64_t)value); }
+    ParameterHasher& add(uint64_t value) { return addBytes(&value, sizeof(value)); }
+    ParameterHasher& add(const std::string& value) {
+        add((uint64_t)value.size());
+        return addBytes(value.data(), value.size());
+    }
+    ParameterHasher& add(const char* value) { return add(std::string(value)); }
+
+    uint64_t value() const { return hash_; }
+
+private:
+    ParameterHasher& addBytes(const void* data, size_t size) {
+        hash_ = hashBytes(data, size, hash_);
+        return *this;
+    }
+
+    uint64_t hash_ = 0;
+};
+
+#endif
@@ -0,0 +1,13 @@
+#include "debug_artifacts.h"
+#include <opencv2/imgcodecs.hpp>
+
+using namespace cv;
+using namespace std;
+
+FileArtifactSink::FileArtifactSink(const string& directory) : directory_(directory) {
+    if (!directory_.empty() && directory_.back() != '/' && directory_.back() != '\\') directory_ += '/';
+}
+
+void FileArtifactSink::write(const char* name, const Mat& image) {
+    imwrite(directory_ + name + ".jpg", image);
+}
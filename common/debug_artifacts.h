@@ -0,0 +1,25 @@
+#ifndef DEBUG_ARTIFACTS_H
+#define DEBUG_ARTIFACTS_H
+
+#include <opencv2/core.hpp>
+#include <string>
+
+// Приемник отладочных изображений (маска красного и т.п.).
+// Подключается через AnalysisContext::artifacts; без него изображения не формируются.
+class DebugArtifactSink {
+public:
+    virtual ~DebugArtifactSink() {}
+    virtual void write(const char* name, const cv::Mat& image) = 0;
+};
+
+// Пишет каждое изображение в <directory><name>.jpg
+class FileArtifactSink : public DebugArtifactSink {
+public:
+    explicit FileArtifactSink(const std::string& directory = "");
+    void write(const char* name, const cv::Mat& image) override;
+
+private:
+    std::string directory_;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "group_metrics.h"
+#include <algorithm>
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+// Порция выстрелов: разности и расстояния порции остаются в кэше
+const size_t CHUNK_SHOTS = 4096;
+
+class GroupMetricsBody : public ParallelLoopBody {
+public:
+    GroupMetricsBody(const ShotGroups& groups, const vector<size_t>& chunks, GroupMetricsBatch& out)
+        : groups_(groups), chunks_(chunks), out_(out) {}
+
+    void operator()(const Range& range) const override {
+        thread_local vector<float> dx, dy, distance;
+        const float* x = groups_.x.data();
+        const float* y = groups_.y.data();
+        const uint64_t* ends = groups_.ends.data();
+
+        for (int c = range.start; c < range.end; ++c) {
+            const size_t g0 = chunks_[c], g1 = chunks_[c + 1];
+            const size_t s0 = g0 > 0 ? (size_t)ends[g0 - 1] : 0;
+            const size_t n = (size_t)ends[g1 - 1] - s0;
+            dx.resize(max(n, (size_t)1));
+            dy.resize(dx.size());
+            distance.resize(dx.size());
+
+            // СТП и смещения выстрелов от нее
+            size_t begin = s0;
+            for (size_t g = g0; g < g1; ++g) {
+                const size_t end = (size_t)ends[g];
+                float sx = 0.0f, sy = 0.0f;
+                for (size_t i = begin; i < end; ++i) {
+                    sx += x[i];
+                    sy += y[i];
+                }
+                const float inv = end > begin ? 1.0f / (float)(end - begin) : 0.0f;
+                sx *= inv;
+                sy *= inv;
+                out_.stp_x[g] = sx;
+                out_.stp_y[g] = sy;
+
+                float* gx = dx.data() + (begin - s0);
+                float* gy = dy.data() + (begin - s0);
+                for (size_t i = 0; i < end - begin; ++i) {
+                    gx[i] = x[begin + i] - sx;
+                    gy[i] = y[begin + i] - sy;
+                }
+                begin = end;
+            }
+
+            // Расстояния до СТП всей порции одним векторным вызовом
+            if (n > 0) {
+                Mat mdx(1, (int)n, CV_32F, dx.data()), mdy(1, (int)n, CV_32F, dy.data());
+                Mat md(1, (int)n, CV_32F, distance.data());
+                magnitude(mdx, mdy, md);
+            }
+
+            begin = s0;
+            for (size_t g = g0; g < g1; ++g) {
+                const size_t end = (size_t)ends[g];
+                const float* d = distance.data() + (begin - s0);
+                float sum = 0.0f, max_d = 0.0f;
+                for (size_t i = 0; i < end - begin; ++i) {
+                    sum += d[i];
+                    max_d = max(max_d, d[i]);
+                }
+                out_.mean_radius[g] = end > begin ? sum / (float)(end - begin) : 0.0f;
+                out_.max_radius[g] = max_d;
+                begin = end;
+            }
+        }
+    }
+
+private:
+    const ShotGroups& groups_;
+    const vector<size_t>& chunks_;
+    GroupMetricsBatch& out_;
+};
+
+}
+
+void ShotGroups::clear() {
+    x.clear();
+    y.clear();
+    ends.clear();
+}
+
+void ShotGroups::add(const vector<Point2f>& shots) {
+    for (const auto& p : shots) {
+        x.push_back(p.x);
+        y.push_back(p.y);
+    }
+    ends.push_back(x.size());
+}
+
+void computeGroupMetrics(const ShotGroups& groups, GroupMetricsBatch& out) {
+    const size_t num_groups = groups.size();
+    out.stp_x.resize(num_groups);
+    out.stp_y.resize(num_groups);
+    out.mean_radius.resize(num_groups);
+    out.max_radius.resize(num_groups);
+    if (num_groups == 0) return;
+
+    // Границы порций по группам: группа не делится, крупная группа - отдельная порция
+    thread_local vector<size_t> chunks;
+    chunks.clear();
+    chunks.push_back(0);
+    uint64_t chunk_start = 0;
+    for (size_t g = 0; g < num_groups; ++g) {
+        if (groups.ends[g] - chunk_start >= CHUNK_SHOTS) {
+            chunks.push_back(g + 1);
+            chunk_start = groups.ends[g];
+        }
+    }
+    if (chunks.back() != num_groups) chunks.push_back(num_groups);
+
+    GroupMetricsBody body(groups, chunks, out);
+    const int num_chunks = (int)chunks.size() - 1;
+    if (num_chunks == 1) body(Range(0, 1));
+    else parallel_for_(Range(0, num_chunks), body);
+}
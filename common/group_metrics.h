@@ -0,0 +1,33 @@
+#ifndef GROUP_METRICS_H
+#define GROUP_METRICS_H
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <vector>
+
+// Пакетный пересчет метрик для множества групп выстрелов (история, перерасчет архива).
+//
+// Группы хранятся структурой массивов: координаты всех выстрелов подряд в x и y,
+// группа g - выстрелы [ends[g - 1], ends[g]) (для g = 0 - с нуля), как колонка holes_end истории.
+struct ShotGroups {
+    std::vector<float> x, y;
+    std::vector<uint64_t> ends;
+
+    size_t size() const { return ends.size(); }
+    void clear();
+    void add(const std::vector<cv::Point2f>& shots);
+};
+
+// Метрики групп в единицах координат: СТП, среднее (кучность) и максимальное (радиус группы) удаление от СТП
+struct GroupMetricsBatch {
+    std::vector<float> stp_x, stp_y;
+    std::vector<float> mean_radius, max_radius;
+};
+
+// СТП - центр масс группы: последовательное построение (ShootingMetricsCalculator::calculateSTP)
+// дает ту же точку, поэтому совпадает с ним до округления float.
+// Выстрелы обрабатываются порциями по несколько тысяч параллельно, расстояния - векторно (cv::magnitude).
+// Выходные массивы переиспользуются между вызовами; пустая группа дает нули
+void computeGroupMetrics(const ShotGroups& groups, GroupMetricsBatch& out);
+
+#endif
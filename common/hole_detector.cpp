@@ -1,45 +1,124 @@
 #include "hole_detector.h"
-#include <iostream>
+#include <opencv2/imgproc.hpp>
+#include "analysis_context.h"
+#include "debug_artifacts.h"
+#include "union_find.h"
+#include "parallel_components.h"
+#include "roi_utils.h"
+#include "profiler.h"
+#include "logger.h"
 #include <algorithm>
+#include <cmath>
 
 using namespace cv;
 using namespace std;
 
-HoleDetector::HoleDetector() {}
+constexpr double HoleDetectorBase::COARSE_PX_PER_CM;
 
-vector<DetectedHole> HoleDetector::detectHoles(const Mat& image, bool debug) {
-    //   
-    double PIXELS_PER_CM = calculatePixelsPerCM(image);
+template <typename Profile>
+vector<DetectedHole> BasicHoleDetector<Profile>::detectHoles(const Mat& image, bool debug) {
+    AnalysisContext ctx(image);
+    FileArtifactSink artifacts;
+    if (debug) ctx.artifacts = &artifacts;
+    detectHoles(ctx);
+    return ctx.detections;
+}
+
+template <typename Profile>
+void BasicHoleDetector<Profile>::detectHoles(AnalysisContext& ctx) {
+    //   ,     
+    ctx.pixels_per_cm = ctx.preset_pixels_per_cm > 0 ? ctx.preset_pixels_per_cm : calculatePixelsPerCM(ctx.image);
+    ctx.pyramid_scale = ctx.coarse_to_fine ? pyramidScale(ctx.pixels_per_cm) : 1;
+    const double PIXELS_PER_CM = ctx.pixels_per_cm;
 
-    // 
-    const double HOOK_ZONE_CM = 7.0;
-    const double MERGE_RADIUS_CM = 1.5;
-    const int MIN_SHOTS = 4;
-    const int MAX_SHOTS = 10;
+    if (ctx.hook_zone_first && detectBelowHookZone(ctx)) return;
 
     //   
-    auto holes = findRedClusters(image, debug);
-    cout << "Found " << holes.size() << " red clusters" << endl;
+    if (ctx.pyramid_scale > 1) findRedClustersCoarseToFine(ctx, 0);
+    else findRedClusters(ctx);
+    TL_LOG_DEBUG("Found " << ctx.clusters.size() << " red clusters");
 
-    if (holes.empty()) return holes;
+    ctx.merged.clear();
+    ctx.detections.clear();
+    if (ctx.clusters.empty()) return;
 
     //   
-    auto merged = mergeCloseHoles(holes, MERGE_RADIUS_CM * PIXELS_PER_CM);
-    cout << "After merging: " << merged.size() << " candidates" << endl;
+    mergeCloseHoles(ctx.clusters, MERGE_RADIUS_CM * PIXELS_PER_CM, ctx.merged, ctx.workspace.merge);
+    TL_LOG_DEBUG("After merging: " << ctx.merged.size() << " candidates");
 
-    //      ()
-    auto split_result = splitByHookZone(merged, HOOK_ZONE_CM, PIXELS_PER_CM);
-    auto lower_holes = split_result.first;
-    auto upper_holes = split_result.second;
+    selectCandidates(ctx.merged, PIXELS_PER_CM, ctx.detections);
+}
+
+//   ,      MIN_SHOTS .   
+// cutoff - 2 * merge_px:     ,       
+// merge_px     (        )   
+//    .  -    .
+//
+//   MAX_SHOTS   :     
+// ,   MAX_SHOTS      ;  
+//   ,      
+template <typename Profile>
+bool BasicHoleDetector<Profile>::detectBelowHookZone(AnalysisContext& ctx) {
+    const double merge_px = MERGE_RADIUS_CM * ctx.pixels_per_cm;
+    const double cutoff_px = Profile::HOOK_ZONE_CM * ctx.pixels_per_cm;
+    const int s = ctx.pyramid_scale;
+
+    //    :         
+    const int top = (int)floor((cutoff_px - 2 * merge_px) / s) * s;
+    if (top <= 0 || top >= ctx.image.rows) return false;
+
+    bool exact = s > 1 ? findRedClustersCoarseToFine(ctx, top) : findRedClustersBelow(ctx, top);
+
+    //        top + 2 * s
+    const double guard = top + merge_px + (s > 1 ? 2.0 * s : 0.0);
+    for (size_t i = 0; i < ctx.clusters.size() && exact; ++i) {
+        if (ctx.clusters[i].center.y < guard) exact = false;
+    }
+    if (!exact) {
+        TL_LOG_DEBUG("Clusters at the scan border, full scan");
+        return false;
+    }
+
+    ctx.merged.clear();
+    ctx.detections.clear();
+    mergeCloseHoles(ctx.clusters, merge_px, ctx.merged, ctx.workspace.merge);
+
+    size_t lower = 0;
+    for (const auto& h : ctx.merged) {
+        if (h.center.y >= cutoff_px) lower++;
+    }
+    if (lower < (size_t)Profile::MIN_SHOTS) {
+        TL_LOG_DEBUG("Below hook zone: " << lower << " holes, full scan");
+        return false;
+    }
 
-    cout << "Lower: " << lower_holes.size() << ", Upper: " << upper_holes.size() << endl;
+    TL_LOG_DEBUG("Below hook zone: " << ctx.clusters.size() << " red clusters, " << ctx.merged.size() << " candidates");
+    selectCandidates(ctx.merged, ctx.pixels_per_cm, ctx.detections);
+    return true;
+}
 
-    //   
-    vector<DetectedHole> final_candidates = lower_holes;
+template <typename Profile>
+void BasicHoleDetector<Profile>::selectCandidates(const vector<DetectedHole>& merged, double pixels_per_cm,
+    vector<DetectedHole>& candidates) {
+    TL_PROFILE_SCOPE("split_hook_zone");
+
+    //  
+    const double HOOK_ZONE_CM = Profile::HOOK_ZONE_CM;
+    const size_t MIN_SHOTS = Profile::MIN_SHOTS;
+    const size_t MAX_SHOTS = Profile::MAX_SHOTS;
+    const double cutoff_px = HOOK_ZONE_CM * pixels_per_cm;
+
+    //   (  )   merged,     -   candidates
+    vector<DetectedHole>& final_candidates = candidates;
+    final_candidates.clear();
+    for (const auto& h : merged) {
+        if (h.center.y >= cutoff_px) final_candidates.push_back(h);
+    }
+    TL_LOG_DEBUG("Lower: " << final_candidates.size() << ", Upper: " << merged.size() - final_candidates.size());
 
     //     
-    for (size_t i = 0; i < upper_holes.size() && final_candidates.size() < MIN_SHOTS; ++i) {
-        final_candidates.push_back(upper_holes[i]);
+    for (size_t i = 0; i < merged.size() && final_candidates.size() < MIN_SHOTS; ++i) {
+        if (merged[i].center.y < cutoff_px) final_candidates.push_back(merged[i]);
     }
 
     ////    ,    
@@ -60,11 +139,10 @@ vector<DetectedHole> HoleDetector::detectHoles(const Mat& image, bool debug) {
         final_candidates.resize(MAX_SHOTS);
     }
 
-    cout << "Final: " << final_candidates.size() << " holes" << endl;
-    return final_candidates;
+    TL_LOG_DEBUG("Final: " << final_candidates.size() << " holes");
 }
 
-double HoleDetector::calculatePixelsPerCM(const Mat& image) {
+double HoleDetectorBase::calculatePixelsPerCM(const Mat& image) {
     const double A3_WIDTH_MM = 300.0;
     const double A3_HEIGHT_MM = 420.0;
 
@@ -72,32 +150,85 @@ double HoleDetector::calculatePixelsPerCM(const Mat& image) {
     double px_per_mm_height = image.rows / A3_HEIGHT_MM;
     double px_per_cm = (px_per_mm_width + px_per_mm_height) / 2.0 * 10.0;
 
-    cout << "Pixels per cm: " << px_per_cm << endl;
+    TL_LOG_DEBUG("Pixels per cm: " << px_per_cm);
     return px_per_cm;
 }
 
-vector<DetectedHole> HoleDetector::findRedClusters(const Mat& image, bool debug) {
-    vector<DetectedHole> holes;
+//      ,   
+template <typename Profile>
+const RedPixelClassifier& BasicHoleDetector<Profile>::redClassifier() {
+    static const RedPixelClassifier classifier(redHsvRanges());
+    return classifier;
+}
 
-    Mat hsv;
-    cvtColor(image, hsv, COLOR_BGR2HSV);
+template <typename Profile>
+DetectionLimits BasicHoleDetector<Profile>::limits() {
+    return { &redClassifier(), MIN_CLUSTER_AREA, MAX_CLUSTER_AREA, MERGE_RADIUS_CM };
+}
 
-    //    
-    Mat mask1, mask2, red_mask;
-    inRange(hsv, Scalar(0, 100, 50), Scalar(10, 255, 255), mask1);
-    inRange(hsv, Scalar(170, 100, 50), Scalar(180, 255, 255), mask2);
-    bitwise_or(mask1, mask2, red_mask);
+template <typename Profile>
+int BasicHoleDetector<Profile>::minClusterArea(const AnalysisContext& ctx) {
+    return max(1, (int)ceil(MIN_CLUSTER_AREA * ctx.area_scale));
+}
 
-    if (debug) imwrite("red_mask.jpg", red_mask);
+template <typename Profile>
+int BasicHoleDetector<Profile>::maxClusterArea(const AnalysisContext& ctx) {
+    return (int)floor(MAX_CLUSTER_AREA * ctx.area_scale);
+}
 
-    //   
-    Mat labels, stats, centroids;
-    int num_components = connectedComponentsWithStats(red_mask, labels, stats, centroids);
+template <typename Profile>
+void BasicHoleDetector<Profile>::findRedClusters(AnalysisContext& ctx) {
+    findRedClustersBelow(ctx, 0);
+}
+
+//    top  ;  - .     ,  
+//       ,     
+static void classifyBelow(const RedPixelClassifier& classifier, const Mat& image, int top, Mat& mask) {
+    if (top <= 0) {
+        classifier.classify(image, mask);
+        return;
+    }
+    mask.create(image.rows, image.cols, CV_8UC1);
+    mask.rowRange(0, top).setTo(Scalar(0));
+    Mat below = mask.rowRange(top, mask.rows);
+    classifier.classify(image.rowRange(top, image.rows), below);
+}
+
+template <typename Profile>
+bool BasicHoleDetector<Profile>::findRedClustersBelow(AnalysisContext& ctx, int top) {
+    vector<DetectedHole>& holes = ctx.clusters;
+    holes.clear();
+
+    //    : BGR ->     
+    Mat& red_mask = ctx.red_mask;
+    {
+        TL_PROFILE_SCOPE("red_mask");
+        classifyBelow(redClassifier(), ctx.image, top, red_mask);
+    }
+
+    if (ctx.artifacts) ctx.artifacts->write("red_mask", red_mask);
+
+    //   :  ,   
+    DetectionWorkspace& ws = ctx.workspace;
+    const Mat& stats = ws.stats;
+    const Mat& centroids = ws.centroids;
+    int num_components;
+    {
+        TL_PROFILE_SCOPE("connected_components");
+        num_components = connectedComponentStats(red_mask, ws.stats, ws.centroids, ws.components);
+    }
 
     //    
+    const int min_area = minClusterArea(ctx);
+    const int max_area = maxClusterArea(ctx);
+    bool exact = true;
     for (int i = 1; i < num_components; i++) {
         int area = stats.at<int>(i, CC_STAT_AREA);
-        if (area < 15 || area > 5000) continue;
+
+        //   :       . 
+        // MAX_CLUSTER_AREA     
+        if (top > 0 && stats.at<int>(i, CC_STAT_TOP) == top && area <= max_area) exact = false;
+        if (area < min_area || area > max_area) continue;
 
         Point2f center(centroids.at<double>(i, 0), centroids.at<double>(i, 1));
         holes.push_back({ center, area });
@@ -107,50 +238,217 @@ vector<DetectedHole> HoleDetector::findRedClusters(const Mat& image, bool debug)
     sort(holes.begin(), holes.end(), [](const DetectedHole& a, const DetectedHole& b) {
         return a.pixel_count > b.pixel_count;
         });
+    return exact;
+}
 
-    return holes;
+int HoleDetectorBase::pyramidScale(double pixels_per_cm) {
+    int scale = 1;
+    while (scale < 8 && pixels_per_cm / (scale * 2) >= COARSE_PX_PER_CM) scale *= 2;
+    return scale;
 }
 
-vector<DetectedHole> HoleDetector::mergeCloseHoles(const vector<DetectedHole>& holes, double merge_px) {
-    vector<DetectedHole> merged;
-    vector<bool> used(holes.size(), false);
-
-    for (size_t i = 0; i < holes.size(); ++i) {
-        if (used[i]) continue;
-
-        Point2f accum = holes[i].center;
-        int accum_pixels = holes[i].pixel_count;
-        int cnt = 1;
-        used[i] = true;
-
-        for (size_t j = i + 1; j < holes.size(); ++j) {
-            if (used[j]) continue;
-            if (norm(holes[i].center - holes[j].center) <= merge_px) {
-                accum += holes[j].center;
-                accum_pixels += holes[j].pixel_count;
-                cnt++;
-                used[j] = true;
-            }
+template <typename Profile>
+bool BasicHoleDetector<Profile>::findRedClustersCoarseToFine(AnalysisContext& ctx, int top) {
+    vector<DetectedHole>& holes = ctx.clusters;
+    holes.clear();
+
+    const Mat& image = ctx.image;
+    const int s = ctx.pyramid_scale;
+    const int coarse_top = top / s;
+
+    //     .   ,     
+    //  (  s):   INTER_AREA       
+    DetectionWorkspace& ws = ctx.workspace;
+    Mat& small = ws.small;
+    Mat& coarse_mask = ctx.red_mask;
+    {
+        TL_PROFILE_SCOPE("red_mask");
+        const Size small_size(image.cols / s, image.rows / s);
+        if (top > 0 && image.rows % s == 0) {
+            small.create(small_size, image.type());
+            Mat below = small.rowRange(coarse_top, small.rows);
+            resize(image.rowRange(top, image.rows), below, below.size(), 0, 0, INTER_AREA);
+        } else {
+            resize(image, small, small_size, 0, 0, INTER_AREA);
         }
-        merged.push_back({ accum * (1.0f / cnt), accum_pixels });
+        classifyBelow(redClassifier(), small, coarse_top, coarse_mask);
     }
 
-    sort(merged.begin(), merged.end(), [](const DetectedHole& a, const DetectedHole& b) {
+    if (ctx.artifacts) ctx.artifacts->write("red_mask", coarse_mask);
+
+    const Mat& stats = ws.stats;
+    int num_components;
+    {
+        TL_PROFILE_SCOPE("connected_components");
+        num_components = connectedComponentStats(coarse_mask, ws.stats, ws.centroids, ws.components);
+    }
+
+    //            ;
+    //   :        
+    const int coarse_max_area = 2 * maxClusterArea(ctx) / (s * s);
+    const Rect image_rect(0, 0, image.cols, image.rows);
+
+    vector<Rect>& windows = ws.windows;
+    windows.clear();
+    for (int i = 1; i < num_components; i++) {
+        if (stats.at<int>(i, CC_STAT_AREA) > coarse_max_area) continue;
+
+        //     ,        
+        //  (   coarse_top + 2):        
+        if (top > 0 && stats.at<int>(i, CC_STAT_TOP) < coarse_top + 4) return false;
+
+        Rect window((stats.at<int>(i, CC_STAT_LEFT) - 2) * s, (stats.at<int>(i, CC_STAT_TOP) - 2) * s,
+            (stats.at<int>(i, CC_STAT_WIDTH) + 4) * s, (stats.at<int>(i, CC_STAT_HEIGHT) + 4) * s);
+        windows.push_back(window & image_rect);
+    }
+    mergeOverlappingRects(windows);
+
+    //      
+    TL_PROFILE_SCOPE("refine_windows");
+    for (const auto& window : windows) {
+        collectClustersInWindow(ctx, window, holes);
+    }
+
+    //   
+    sort(holes.begin(), holes.end(), [](const DetectedHole& a, const DetectedHole& b) {
         return a.pixel_count > b.pixel_count;
         });
+    return true;
+}
+
+template <typename Profile>
+void BasicHoleDetector<Profile>::collectClustersInWindow(AnalysisContext& ctx, const Rect& window,
+    vector<DetectedHole>& holes) {
+    const Mat& image = ctx.image;
+    DetectionWorkspace& ws = ctx.workspace;
+    redClassifier().classify(image(window), ws.window_mask);
+
+    //       ,   
+    int num_components = connectedComponentStats(ws.window_mask, ws.stats, ws.centroids, ws.components);
+    const Mat& stats = ws.stats;
+    const Mat& centroids = ws.centroids;
 
+    const int min_area = minClusterArea(ctx);
+    const int max_area = maxClusterArea(ctx);
+    for (int i = 1; i < num_components; i++) {
+        int area = stats.at<int>(i, CC_STAT_AREA);
+        if (area < min_area || area > max_area) continue;
+
+        //    -   ,  
+        Rect bbox(stats.at<int>(i, CC_STAT_LEFT) + window.x, stats.at<int>(i, CC_STAT_TOP) + window.y,
+            stats.at<int>(i, CC_STAT_WIDTH), stats.at<int>(i, CC_STAT_HEIGHT));
+        if (touchesInnerBorder(bbox, window, image.size())) continue;
+
+        Point2f center(centroids.at<double>(i, 0) + window.x, centroids.at<double>(i, 1) + window.y);
+        holes.push_back({ center, area });
+    }
+}
+
+double HoleDetectorBase::sheetsPixelsPerCM(const Size& size, int sheets_across) {
+    const double A3_WIDTH_CM = 30.0;
+    const double A3_HEIGHT_CM = 42.0;
+    return (size.width / (A3_WIDTH_CM * max(sheets_across, 1)) + size.height / A3_HEIGHT_CM) / 2.0;
+}
+
+vector<DetectedHole> HoleDetectorBase::mergeCloseHoles(const vector<DetectedHole>& holes, double merge_px) {
+    vector<DetectedHole> merged;
+    MergeWorkspace workspace;
+    mergeCloseHoles(holes, merge_px, merged, workspace);
     return merged;
 }
 
-pair<vector<DetectedHole>, vector<DetectedHole>>
-HoleDetector::splitByHookZone(const vector<DetectedHole>& holes, double hook_zone_cm, double pixels_per_cm) {
-    vector<DetectedHole> lower, upper;
-    double cutoff_px = hook_zone_cm * pixels_per_cm;
+void HoleDetectorBase::mergeCloseHoles(const vector<DetectedHole>& holes, double merge_px,
+    vector<DetectedHole>& merged, MergeWorkspace& ws) {
+    TL_PROFILE_SCOPE("merge_close_holes");
+    merged.clear();
+    const size_t n = holes.size();
+    if (n == 0) return;
+
+    //   ( ),       
+    vector<int>& order = ws.order;
+    order.resize(n);
+    for (size_t i = 0; i < n; ++i) order[i] = (int)i;
+    sort(order.begin(), order.end(), [&holes](int a, int b) {
+        const DetectedHole& ha = holes[a];
+        const DetectedHole& hb = holes[b];
+        if (ha.center.y != hb.center.y) return ha.center.y < hb.center.y;
+        if (ha.center.x != hb.center.x) return ha.center.x < hb.center.x;
+        return ha.pixel_count < hb.pixel_count;
+        });
 
-    for (const auto& h : holes) {
-        if (h.center.y < cutoff_px) upper.push_back(h);
-        else lower.push_back(h);
+    //     merge_px:     3x3 
+    const double cell = max(merge_px, 1.0);
+    auto cellKey = [](long long cx, long long cy) {
+        return ((unsigned long long)cy << 32) ^ (unsigned long long)(unsigned int)cx;
+    };
+
+    vector<pair<unsigned long long, int>>& cells = ws.cells;
+    vector<long long>& cell_x = ws.cell_x;
+    vector<long long>& cell_y = ws.cell_y;
+    cells.resize(n);
+    cell_x.resize(n);
+    cell_y.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        const Point2f& c = holes[order[i]].center;
+        cell_x[i] = (long long)floor(c.x / cell);
+        cell_y[i] = (long long)floor(c.y / cell);
+        cells[i] = make_pair(cellKey(cell_x[i], cell_y[i]), (int)i);
+    }
+    sort(cells.begin(), cells.end());
+
+    //     merge_px ()
+    UnionFind& uf = ws.uf;
+    uf.reset(n);
+    const double merge_sq = merge_px * merge_px;
+    for (size_t i = 0; i < n; ++i) {
+        const Point2f& ci = holes[order[i]].center;
+        for (long long dy = -1; dy <= 1; ++dy) {
+            for (long long dx = -1; dx <= 1; ++dx) {
+                unsigned long long key = cellKey(cell_x[i] + dx, cell_y[i] + dy);
+                auto it = lower_bound(cells.begin(), cells.end(), make_pair(key, 0));
+                for (; it != cells.end() && it->first == key; ++it) {
+                    size_t j = (size_t)it->second;
+                    if (j <= i) continue;
+                    const Point2f& cj = holes[order[j]].center;
+                    double ddx = ci.x - cj.x, ddy = ci.y - cj.y;
+                    if (ddx * ddx + ddy * ddy <= merge_sq) uf.unite((int)i, (int)j);
+                }
+            }
+        }
     }
 
-    return make_pair(lower, upper);
-}
\ No newline at end of file
+    //     
+    vector<int>& group_of = ws.group_of;
+    vector<Point2f>& accum = ws.accum;
+    vector<int>& counts = ws.counts;
+    group_of.assign(n, -1);
+    accum.clear();
+    counts.clear();
+    for (size_t i = 0; i < n; ++i) {
+        int root = uf.find((int)i);
+        if (group_of[root] < 0) {
+            group_of[root] = (int)merged.size();
+            merged.push_back({ Point2f(0, 0), 0 });
+            accum.push_back(Point2f(0, 0));
+            counts.push_back(0);
+        }
+        int g = group_of[root];
+        accum[g] += holes[order[i]].center;
+        merged[g].pixel_count += holes[order[i]].pixel_count;
+        counts[g]++;
+    }
+    for (size_t g = 0; g < merged.size(); ++g) {
+        merged[g].center = accum[g] * (1.0f / counts[g]);
+    }
+
+    //  ,   -  
+    sort(merged.begin(), merged.end(), [](const DetectedHole& a, const DetectedHole& b) {
+        if (a.pixel_count != b.pixel_count) return a.pixel_count > b.pixel_count;
+        if (a.center.y != b.center.y) return a.center.y < b.center.y;
+        return a.center.x < b.center.x;
+        });
+}
+
+template class BasicHoleDetector<PMProfile>;
+template class BasicHoleDetector<AKProfile>;
+template class BasicHoleDetector<RifleProfile>;
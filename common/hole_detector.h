@@ -1,25 +1,120 @@
 #ifndef HOLE_DETECTOR_H
 #define HOLE_DETECTOR_H
 
-#include <opencv2/opencv.hpp>
+#include <opencv2/core.hpp>
+#include <utility>
 #include <vector>
+#include "red_classifier.h"
+#include "weapon_profiles.h"
+#include "parallel_components.h"
+#include "union_find.h"
 
 struct DetectedHole {
     cv::Point2f center;
     int pixel_count;
 };
 
-class HoleDetector {
+struct AnalysisContext;
+
+// Временные буферы объединения близких пробоин
+struct MergeWorkspace {
+    std::vector<int> order;
+    std::vector<std::pair<unsigned long long, int>> cells;
+    std::vector<long long> cell_x, cell_y;
+    UnionFind uf;
+    std::vector<int> group_of;
+    std::vector<cv::Point2f> accum;
+    std::vector<int> counts;
+};
+
+// Буферы детектора, переживающие снимок. Живут в AnalysisContext: при повторном использовании
+// контекста на снимках того же размера детекция не выделяет память
+struct DetectionWorkspace {
+    ComponentsWorkspace components;
+    cv::Mat stats, centroids;               // статистика связных компонент
+    cv::Mat small;                          // уменьшенная копия грубого прохода
+    cv::Mat window_mask;
+    std::vector<cv::Rect> windows;
+    MergeWorkspace merge;
+};
+
+// Пороги профиля для кода, который выбирает профиль во время выполнения (StreamHoleTracker)
+struct DetectionLimits {
+    const RedPixelClassifier* red_classifier;
+    int min_cluster_area;                   // пикс полного разрешения
+    int max_cluster_area;
+    double merge_radius_cm;
+};
+
+// Общая для всех профилей часть детектора
+class HoleDetectorBase {
 public:
-    HoleDetector();
-    std::vector<DetectedHole> detectHoles(const cv::Mat& image, bool debug = false);
     double calculatePixelsPerCM(const cv::Mat& image);
 
-private:
-    std::vector<DetectedHole> findRedClusters(const cv::Mat& image, bool debug);
+    // Масштаб для sheets_across листов A3 рядом (вертикальных), заполняющих кадр
+    static double sheetsPixelsPerCM(const cv::Size& size, int sheets_across);
     std::vector<DetectedHole> mergeCloseHoles(const std::vector<DetectedHole>& holes, double merge_px);
-    std::pair<std::vector<DetectedHole>, std::vector<DetectedHole>>
-        splitByHookZone(const std::vector<DetectedHole>& holes, double hook_zone_cm, double pixels_per_cm);
+    void mergeCloseHoles(const std::vector<DetectedHole>& holes, double merge_px, std::vector<DetectedHole>& merged,
+        MergeWorkspace& workspace);
+
+    // Грубый проход пирамиды ведется примерно при таком масштабе
+    static constexpr double COARSE_PX_PER_CM = 8.0;
+    static int pyramidScale(double pixels_per_cm);
+};
+
+// Детектор, специализированный под профиль упражнения (weapon_profiles.h).
+// Инстанцируется явно в hole_detector.cpp для каждого профиля.
+template <typename Profile>
+class BasicHoleDetector : public HoleDetectorBase {
+public:
+    BasicHoleDetector() {}
+    std::vector<DetectedHole> detectHoles(const cv::Mat& image, bool debug = false);
+    void detectHoles(AnalysisContext& ctx);
+
+    void findRedClusters(AnalysisContext& ctx);
+
+    // Выбор пробоин одной группы из объединенных кандидатов: сначала ниже зоны крючков,
+    // добор из нее до MIN_SHOTS, не больше MAX_SHOTS. Без промежуточных копий: можно вызывать
+    // из нескольких потоков для разных групп
+    void selectCandidates(const std::vector<DetectedHole>& merged, double pixels_per_cm,
+        std::vector<DetectedHole>& candidates);
+
+    // Пороги красного в HSV
+    static std::vector<HsvRange> redHsvRanges() { return Profile::redHsvRanges(); }
+    static const RedPixelClassifier& redClassifier();
+
+    // Допустимая площадь кластера (пикс) и радиус объединения
+    static constexpr int MIN_CLUSTER_AREA = Profile::MIN_CLUSTER_AREA;
+    static constexpr int MAX_CLUSTER_AREA = Profile::MAX_CLUSTER_AREA;
+    static constexpr double MERGE_RADIUS_CM = Profile::MERGE_RADIUS_CM;
+
+    // Пороги площади в пикселях снимка ctx: профиль задан для полного разрешения, на уменьшенном
+    // снимке (ctx.area_scale < 1) пороги уменьшаются так, чтобы площадь в см^2 оставалась той же
+    static int minClusterArea(const AnalysisContext& ctx);
+    static int maxClusterArea(const AnalysisContext& ctx);
+
+    static DetectionLimits limits();
+
+private:
+    // Поиск кластеров в строках от top и ниже (выше маска обнуляется). Возвращает false, если
+    // результат может отличаться от поиска по всему листу (компонента или окно у границы области)
+    bool findRedClustersBelow(AnalysisContext& ctx, int top);
+    bool findRedClustersCoarseToFine(AnalysisContext& ctx, int top);
+
+    // Режим hook_zone_first: детекция ниже зоны крючков; false - нужен полный проход
+    bool detectBelowHookZone(AnalysisContext& ctx);
+    void collectClustersInWindow(AnalysisContext& ctx, const cv::Rect& window, std::vector<DetectedHole>& holes);
 };
 
+template <typename Profile> constexpr int BasicHoleDetector<Profile>::MIN_CLUSTER_AREA;
+template <typename Profile> constexpr int BasicHoleDetector<Profile>::MAX_CLUSTER_AREA;
+template <typename Profile> constexpr double BasicHoleDetector<Profile>::MERGE_RADIUS_CM;
+
+extern template class BasicHoleDetector<PMProfile>;
+extern template class BasicHoleDetector<AKProfile>;
+extern template class BasicHoleDetector<RifleProfile>;
+
+// Детектор по умолчанию (ПМ)
+typedef BasicHoleDetector<PMProfile> HoleDetector;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "image_ingest.h"
+#include "profiler.h"
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace cv;
+using namespace std;
+
+bool MappedFile::open(const string& path) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    file_ = file;
+    mapping_ = mapping;
+    data_ = static_cast<const unsigned char*>(view);
+    size_ = (size_t)file_size.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+    madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    fd_ = fd;
+    data_ = static_cast<const unsigned char*>(view);
+    size_ = (size_t)st.st_size;
+#endif
+    return true;
+}
+
+void MappedFile::close() {
+    if (!data_) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    CloseHandle(file_);
+    file_ = nullptr;
+    mapping_ = nullptr;
+#else
+    munmap(const_cast<unsigned char*>(data_), size_);
+    ::close(fd_);
+    fd_ = -1;
+#endif
+    data_ = nullptr;
+    size_ = 0;
+}
+
+bool readJpegSize(const unsigned char* data, size_t size, int& width, int& height) {
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) return false;
+
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) return false;
+        unsigned char marker = data[pos + 1];
+        if (marker == 0xFF) {           // заполнитель
+            pos++;
+            continue;
+        }
+        if (marker == 0xD8 || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            pos += 2;                   // маркеры без длины
+            continue;
+        }
+
+        size_t length = ((size_t)data[pos + 2] << 8) | data[pos + 3];
+        bool is_sof = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (is_sof) {
+            if (pos + 9 > size) return false;
+            height = (data[pos + 5] << 8) | data[pos + 6];
+            width = (data[pos + 7] << 8) | data[pos + 8];
+            return width > 0 && height > 0;
+        }
+        if (marker == 0xDA) return false;   // начались данные скана, SOF не встретился
+        pos += 2 + length;
+    }
+    return false;
+}
+
+bool ingestBuffer(const unsigned char* data, size_t size, const IngestOptions& options, IngestedImage& out,
+    string* error) {
+    // Буфер out.image сохраняется: снимок того же размера декодируется в ту же память
+    out.reduction = 1;
+    out.original_width = 0;
+    out.original_height = 0;
+    int flags = IMREAD_COLOR;
+
+    int width = 0, height = 0;
+    if (readJpegSize(data, size, width, height)) {
+        out.original_width = width;
+        out.original_height = height;
+
+        if (options.target_pixels_per_cm > 0) {
+            // Масштаб по допущению листа A3, как в HoleDetector::calculatePixelsPerCM (ориентация не важна)
+            double ppc = (min(width, height) / 30.0 + max(width, height) / 42.0) / 2.0;
+            if (ppc / 8 >= options.target_pixels_per_cm) {
+                out.reduction = 8;
+                flags = IMREAD_REDUCED_COLOR_8;
+            } else if (ppc / 4 >= options.target_pixels_per_cm) {
+                out.reduction = 4;
+                flags = IMREAD_REDUCED_COLOR_4;
+            } else if (ppc / 2 >= options.target_pixels_per_cm) {
+                out.reduction = 2;
+                flags = IMREAD_REDUCED_COLOR_2;
+            }
+        }
+    }
+
+    // Отображение оборачивается без копирования, декодер читает прямо из него
+    Mat encoded(1, (int)size, CV_8UC1, const_cast<unsigned char*>(data));
+    bool decoded;
+    {
+        TL_PROFILE_SCOPE("decode");
+        decoded = !imdecode(encoded, flags, &out.image).empty();
+    }
+    if (!decoded) {
+        out.image.release();
+        if (error) *error = "cannot decode image";
+        return false;
+    }
+
+    if (out.original_width == 0) {
+        out.original_width = out.image.cols;
+        out.original_height = out.image.rows;
+    }
+    return true;
+}
+
+bool ingestImage(const string& path, const IngestOptions& options, IngestedImage& out, string* error) {
+    MappedFile file;
+    if (!file.open(path)) {
+        if (error) *error = "cannot open image";
+        return false;
+    }
+    return ingestBuffer(file.data(), file.size(), options, out, error);
+}
@@ -0,0 +1,62 @@
+#ifndef IMAGE_INGEST_H
+#define IMAGE_INGEST_H
+
+#include <opencv2/core.hpp>
+#include <string>
+#include <cstddef>
+
+// Файл, отображенный в память только для чтения
+class MappedFile {
+public:
+    MappedFile() {}
+    explicit MappedFile(const std::string& path) { open(path); }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return data_ != nullptr; }
+    const unsigned char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
+
+// Размер JPEG из маркера SOF, без декодирования
+bool readJpegSize(const unsigned char* data, size_t size, int& width, int& height);
+
+struct IngestOptions {
+    // Желаемый масштаб после декодирования; 0 - полное разрешение.
+    // Для JPEG выбирается наибольшее уменьшение 1/2, 1/4, 1/8, при котором масштаб не ниже заданного
+    double target_pixels_per_cm = 0.0;
+};
+
+struct IngestedImage {
+    cv::Mat image;
+    int reduction = 1;          // во сколько раз уменьшено при декодировании
+    int original_width = 0;
+    int original_height = 0;
+};
+
+// Отображает файл в память и декодирует прямо из отображения.
+// Память out.image переиспользуется, если размер снимка не изменился: изображение предыдущего
+// вызова, на которое остались ссылки, будет перезаписано
+bool ingestImage(const std::string& path, const IngestOptions& options, IngestedImage& out,
+    std::string* error = nullptr);
+
+// То же для снимка, уже находящегося в памяти
+bool ingestBuffer(const unsigned char* data, size_t size, const IngestOptions& options, IngestedImage& out,
+    std::string* error = nullptr);
+
+#endif
@@ -0,0 +1,95 @@
+#include "logger.h"
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+std::atomic<int> Logger::level_((int)LogLevel::Info);
+
+namespace {
+
+const size_t FLUSH_THRESHOLD = 8192;
+
+struct ThreadLog {
+    mutex lock;
+    string buffer;
+};
+
+struct LogState {
+    mutex lock;                                 // вывод и список буферов
+    ostream* output = &clog;
+    vector<shared_ptr<ThreadLog>> buffers;
+};
+
+LogState& state() {
+    static LogState s;
+    return s;
+}
+
+// Буферы не сбрасываются при завершении потока: потоки пула могут
+// жить до разрушения статических объектов, поэтому сброс - только явный
+ThreadLog& threadLog() {
+    thread_local shared_ptr<ThreadLog> log;
+    if (!log) {
+        log = make_shared<ThreadLog>();
+        LogState& s = state();
+        lock_guard<mutex> guard(s.lock);
+        s.buffers.push_back(log);
+    }
+    return *log;
+}
+
+const char* levelName(LogLevel level) {
+    switch (level) {
+    case LogLevel::Debug: return "DEBUG";
+    case LogLevel::Info: return "INFO";
+    case LogLevel::Warning: return "WARN";
+    case LogLevel::Error: return "ERROR";
+    default: return "";
+    }
+}
+
+// Вызывается под блокировкой буфера потока
+void drain(ThreadLog& log) {
+    if (log.buffer.empty()) return;
+    LogState& s = state();
+    lock_guard<mutex> guard(s.lock);
+    s.output->write(log.buffer.data(), (streamsize)log.buffer.size());
+    s.output->flush();
+    log.buffer.clear();
+}
+
+} // namespace
+
+void Logger::setOutput(ostream* os) {
+    LogState& s = state();
+    lock_guard<mutex> guard(s.lock);
+    s.output = os ? os : &clog;
+}
+
+void Logger::write(LogLevel level, const string& message) {
+    ThreadLog& log = threadLog();
+    lock_guard<mutex> guard(log.lock);
+    log.buffer += '[';
+    log.buffer += levelName(level);
+    log.buffer += "] ";
+    log.buffer += message;
+    log.buffer += '\n';
+
+    if (level >= LogLevel::Warning || log.buffer.size() >= FLUSH_THRESHOLD) drain(log);
+}
+
+void Logger::flushAll() {
+    vector<shared_ptr<ThreadLog>> buffers;
+    {
+        LogState& s = state();
+        lock_guard<mutex> guard(s.lock);
+        buffers = s.buffers;
+    }
+    for (auto& log : buffers) {
+        lock_guard<mutex> guard(log->lock);
+        drain(*log);
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+// Уровни журнала по возрастанию важности
+enum class LogLevel { Debug = 0, Info = 1, Warning = 2, Error = 3, Off = 4 };
+
+// Минимальный уровень, попадающий в сборку: вызовы ниже вырезаются препроцессором.
+// По умолчанию в релизе (NDEBUG) отладочные сообщения не компилируются.
+#ifndef TARGETLOCK_MIN_LOG_LEVEL
+#ifdef NDEBUG
+#define TARGETLOCK_MIN_LOG_LEVEL 1
+#else
+#define TARGETLOCK_MIN_LOG_LEVEL 0
+#endif
+#endif
+
+// Журнал с буфером на поток: строки копятся локально и сбрасываются в поток вывода пачками
+// (при заполнении буфера, на предупреждениях и ошибках, по flushAll), без общей блокировки на каждую строку.
+class Logger {
+public:
+    static void setLevel(LogLevel level) { level_.store((int)level, std::memory_order_relaxed); }
+    static LogLevel level() { return (LogLevel)level_.load(std::memory_order_relaxed); }
+    static bool enabled(LogLevel level) { return (int)level >= level_.load(std::memory_order_relaxed); }
+
+    // Поток вывода (по умолчанию std::clog); задается до начала работы
+    static void setOutput(std::ostream* os);
+
+    static void write(LogLevel level, const std::string& message);
+
+    // Сбросить буферы всех потоков (в конце пакета / перед выходом)
+    static void flushAll();
+
+private:
+    static std::atomic<int> level_;
+};
+
+// Одна строка журнала, уходит в буфер потока в деструкторе
+class LogLine {
+public:
+    explicit LogLine(LogLevel level) : level_(level) {}
+    ~LogLine() { Logger::write(level_, stream_.str()); }
+
+    std::ostringstream& stream() { return stream_; }
+
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+
+private:
+    LogLevel level_;
+    std::ostringstream stream_;
+};
+
+#define TL_LOG(level, expr) \
+    do { if (Logger::enabled(level)) { LogLine tl_log_line_(level); tl_log_line_.stream() << expr; } } while (0)
+
+#if TARGETLOCK_MIN_LOG_LEVEL <= 0
+#define TL_LOG_DEBUG(expr) TL_LOG(LogLevel::Debug, expr)
+#else
+#define TL_LOG_DEBUG(expr) do {} while (0)
+#endif
+
+#if TARGETLOCK_MIN_LOG_LEVEL <= 1
+#define TL_LOG_INFO(expr) TL_LOG(LogLevel::Info, expr)
+#else
+#define TL_LOG_INFO(expr) do {} while (0)
+#endif
+
+#if TARGETLOCK_MIN_LOG_LEVEL <= 2
+#define TL_LOG_WARNING(expr) TL_LOG(LogLevel::Warning, expr)
+#else
+#define TL_LOG_WARNING(expr) do {} while (0)
+#endif
+
+#define TL_LOG_ERROR(expr) TL_LOG(LogLevel::Error, expr)
+
+#endif
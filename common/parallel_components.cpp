@@ -0,0 +1,273 @@
+#include "parallel_components.h"
+#include <opencv2/imgproc.hpp>
+#include "union_find.h"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+// Полоса меньше этого числа строк не выделяется: сшивка дороже выигрыша
+const int MIN_STRIP_ROWS = 32;
+
+struct ComponentAccum {
+    int left = INT_MAX, top = INT_MAX, right = INT_MIN, bottom = INT_MIN;
+    int64_t area = 0;
+    uint64_t sum_x = 0, sum_y = 0;
+    int64_t first_block = INT64_MAX;        // первый блок 2x2 компоненты в порядке обхода блоков
+
+    void add(int x, int y, int64_t block) {
+        first_block = min(first_block, block);
+        left = min(left, x);
+        right = max(right, x);
+        top = min(top, y);
+        bottom = max(bottom, y);
+        area++;
+        sum_x += (uint64_t)x;
+        sum_y += (uint64_t)y;
+    }
+
+    void merge(const ComponentAccum& o) {
+        if (o.area == 0) return;
+        left = min(left, o.left);
+        right = max(right, o.right);
+        top = min(top, o.top);
+        bottom = max(bottom, o.bottom);
+        area += o.area;
+        sum_x += o.sum_x;
+        sum_y += o.sum_y;
+        first_block = min(first_block, o.first_block);
+    }
+};
+
+// Результат первого прохода по полосе. Метки в строках - локальный индекс + 1, 0 - фон
+struct StripLabels {
+    UnionFind uf;
+    vector<ComponentAccum> accum;
+    vector<int> first_row, last_row;
+    vector<int> rows[2];                    // текущая и предыдущая строка меток
+    ComponentAccum background;
+
+    // Очистка без освобождения памяти
+    void reset(int cols) {
+        uf.reset(0);
+        accum.clear();
+        rows[0].assign(cols, 0);
+        rows[1].assign(cols, 0);
+        background = ComponentAccum();
+    }
+};
+
+class StripBody : public ParallelLoopBody {
+public:
+    StripBody(const Mat& mask, int strip_rows, vector<StripLabels>& strips)
+        : mask_(mask), strip_rows_(strip_rows), strips_(strips) {}
+
+    void operator()(const Range& range) const override {
+        for (int k = range.start; k < range.end; ++k) {
+            int r0 = k * strip_rows_;
+            int r1 = min(mask_.rows, r0 + strip_rows_);
+            labelStrip(r0, r1, strips_[k]);
+        }
+    }
+
+private:
+    const Mat& mask_;
+    int strip_rows_;
+    vector<StripLabels>& strips_;
+
+    void labelStrip(int r0, int r1, StripLabels& strip) const {
+        const int cols = mask_.cols;
+        const uint64_t row_sum_x = (uint64_t)cols * (cols - 1) / 2;
+        const int64_t block_cols = (cols + 1) / 2;
+        strip.reset(cols);
+        vector<int>* rows = strip.rows;
+
+        for (int y = r0; y < r1; ++y) {
+            const uchar* m = mask_.ptr<uchar>(y);
+            const uchar* mp = y > r0 ? mask_.ptr<uchar>(y - 1) : nullptr;
+            int* cur = rows[y & 1].data();
+            const int* prev = rows[(y - 1) & 1].data();
+
+            const int64_t block_row = (int64_t)(y >> 1) * block_cols;
+            int fg_count = 0;
+            uint64_t fg_sum_x = 0;
+
+            for (int x = 0; x < cols; ++x) {
+                if (!m[x]) {
+                    cur[x] = 0;
+                    continue;
+                }
+                fg_count++;
+                fg_sum_x += (uint64_t)x;
+
+                // Соседи, уже пройденные в порядке обхода: W, NW, N, NE
+                int l = (x > 0 && m[x - 1]) ? cur[x - 1] : 0;
+                if (mp) {
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        int nx = x + dx;
+                        if (nx < 0 || nx >= cols || !mp[nx]) continue;
+                        int nl = prev[nx];
+                        if (l == 0) l = nl;
+                        else if (nl != l) strip.uf.unite(l - 1, nl - 1);
+                    }
+                }
+                if (l == 0) {
+                    l = strip.uf.add() + 1;
+                    strip.accum.push_back(ComponentAccum());
+                }
+                cur[x] = l;
+                strip.accum[l - 1].add(x, y, block_row + (x >> 1));
+            }
+
+            // Фон строки - через суммы по всей строке за вычетом переднего плана
+            int zeros = cols - fg_count;
+            if (zeros > 0) {
+                ComponentAccum& bg = strip.background;
+                int first = 0, last = cols - 1;
+                while (m[first]) first++;
+                while (m[last]) last--;
+                bg.left = min(bg.left, first);
+                bg.right = max(bg.right, last);
+                bg.top = min(bg.top, y);
+                bg.bottom = max(bg.bottom, y);
+                bg.area += zeros;
+                bg.sum_x += row_sum_x - fg_sum_x;
+                bg.sum_y += (uint64_t)zeros * (uint64_t)y;
+            }
+
+            if (y == r0) strip.first_row.assign(cur, cur + cols);
+            if (y == r1 - 1) strip.last_row.assign(cur, cur + cols);
+        }
+    }
+};
+
+} // namespace
+
+struct ComponentsWorkspace::Buffers {
+    vector<StripLabels> strips;
+    vector<int> offsets;
+    UnionFind uf;
+    vector<int> root_index;
+    vector<ComponentAccum> merged;
+    vector<ComponentAccum> components;
+    Mat stats, centroids;                   // с запасом по строкам; наружу отдается rowRange
+};
+
+ComponentsWorkspace::ComponentsWorkspace() : buffers_(new Buffers()) {}
+
+ComponentsWorkspace::~ComponentsWorkspace() {}
+
+int connectedComponentStats(const Mat& mask, Mat& stats, Mat& centroids) {
+    ComponentsWorkspace workspace;
+    return connectedComponentStats(mask, stats, centroids, workspace);
+}
+
+int connectedComponentStats(const Mat& mask, Mat& stats, Mat& centroids, ComponentsWorkspace& workspace) {
+    CV_Assert(mask.type() == CV_8UC1);
+    ComponentsWorkspace::Buffers& ws = *workspace.buffers_;
+    const int cols = mask.cols;
+
+    // Полос - с запасом относительно числа потоков, для балансировки
+    int max_strips = max(1, mask.rows / MIN_STRIP_ROWS);
+    int num_strips = min(max_strips, max(1, getNumThreads() * 4));
+    int strip_rows = (mask.rows + num_strips - 1) / max(num_strips, 1);
+    num_strips = strip_rows > 0 ? (mask.rows + strip_rows - 1) / strip_rows : 0;
+
+    vector<StripLabels>& strips = ws.strips;
+    strips.resize(num_strips);
+    if (num_strips > 0) {
+        parallel_for_(Range(0, num_strips), StripBody(mask, strip_rows, strips), (double)num_strips);
+    }
+
+    // Глобальные индексы: полосы подряд, внутри полосы - в порядке создания меток (порядок обхода)
+    vector<int>& offsets = ws.offsets;
+    offsets.assign(num_strips + 1, 0);
+    for (int k = 0; k < num_strips; ++k) offsets[k + 1] = offsets[k] + (int)strips[k].accum.size();
+    const int total = offsets[num_strips];
+
+    UnionFind& uf = ws.uf;
+    uf.reset((size_t)total);
+    for (int k = 0; k < num_strips; ++k) {
+        StripLabels& strip = strips[k];
+        for (int i = 0; i < (int)strip.accum.size(); ++i) {
+            uf.unite(offsets[k] + i, offsets[k] + strip.uf.find(i));
+        }
+    }
+
+    // Сшивка по границам полос: последняя строка полосы k-1 с первой строкой полосы k
+    for (int k = 1; k < num_strips; ++k) {
+        const vector<int>& above = strips[k - 1].last_row;
+        const vector<int>& below = strips[k].first_row;
+        for (int x = 0; x < cols; ++x) {
+            if (!below[x]) continue;
+            for (int dx = -1; dx <= 1; ++dx) {
+                int nx = x + dx;
+                if (nx < 0 || nx >= cols || !above[nx]) continue;
+                uf.unite(offsets[k] + below[x] - 1, offsets[k - 1] + above[nx] - 1);
+            }
+        }
+    }
+
+    // Сводим статистику по корням
+    vector<int>& root_index = ws.root_index;
+    vector<ComponentAccum>& merged = ws.merged;
+    root_index.assign(total, -1);
+    merged.clear();
+    for (int p = 0; p < total; ++p) {
+        if (uf.find(p) == p) {
+            root_index[p] = (int)merged.size();
+            merged.push_back(ComponentAccum());
+        }
+    }
+    ComponentAccum background;
+    for (int k = 0; k < num_strips; ++k) {
+        background.merge(strips[k].background);
+        for (int i = 0; i < (int)strips[k].accum.size(); ++i) {
+            merged[root_index[uf.find(offsets[k] + i)]].merge(strips[k].accum[i]);
+        }
+    }
+
+    // Разметка OpenCV по умолчанию (BBDT / Spaghetti) обходит блоки 2x2 и нумерует компоненты
+    // в порядке первого блока; блок 8-связен, поэтому ключ у каждой компоненты свой
+    sort(merged.begin(), merged.end(), [](const ComponentAccum& a, const ComponentAccum& b) {
+        return a.first_block < b.first_block;
+        });
+
+    const int num_labels = (int)merged.size() + 1;
+    vector<ComponentAccum>& components = ws.components;
+    components.clear();
+    components.push_back(background);
+    components.insert(components.end(), merged.begin(), merged.end());
+
+    // Число компонент меняется от снимка к снимку: хранилище растет с запасом и не пересоздается
+    if (ws.stats.rows < num_labels) {
+        const int capacity = max(num_labels, 2 * ws.stats.rows);
+        ws.stats.create(capacity, 5, CV_32S);
+        ws.centroids.create(capacity, 2, CV_64F);
+    }
+    stats = ws.stats.rowRange(0, num_labels);
+    centroids = ws.centroids.rowRange(0, num_labels);
+    for (int l = 0; l < num_labels; ++l) {
+        const ComponentAccum& c = components[l];
+        int* s = stats.ptr<int>(l);
+        double* ct = centroids.ptr<double>(l);
+        if (c.area == 0) {
+            s[CC_STAT_LEFT] = s[CC_STAT_TOP] = s[CC_STAT_WIDTH] = s[CC_STAT_HEIGHT] = s[CC_STAT_AREA] = 0;
+            ct[0] = ct[1] = 0.0;
+            continue;
+        }
+        s[CC_STAT_LEFT] = c.left;
+        s[CC_STAT_TOP] = c.top;
+        s[CC_STAT_WIDTH] = c.right - c.left + 1;
+        s[CC_STAT_HEIGHT] = c.bottom - c.top + 1;
+        s[CC_STAT_AREA] = (int)c.area;
+        ct[0] = (double)c.sum_x / (double)c.area;
+        ct[1] = (double)c.sum_y / (double)c.area;
+    }
+    return num_labels;
+}
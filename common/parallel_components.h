@@ -0,0 +1,35 @@
+#ifndef PARALLEL_COMPONENTS_H
+#define PARALLEL_COMPONENTS_H
+
+#include <opencv2/core.hpp>
+#include <memory>
+
+// Связные компоненты (8-связность) маски CV_8UC1, разметка горизонтальными полосами параллельно.
+// Компоненты, пересекающие границы полос, сшиваются через систему непересекающихся множеств.
+//
+// stats (CV_32S, N x 5) и centroids (CV_64F, N x 2) совпадают с cv::connectedComponentsWithStats
+// (8-связность, алгоритм по умолчанию): нумерация - по первому блоку 2x2 компоненты, строка 0 - фон,
+// центроиды - целочисленные суммы координат, деленные на площадь.
+// Карта меток не строится: в памяти только две строки меток на полосу.
+// Возвращает число меток вместе с фоном.
+int connectedComponentStats(const cv::Mat& mask, cv::Mat& stats, cv::Mat& centroids);
+
+// Буферы разметки между вызовами. При повторных вызовах на масках того же размера
+// (и с тем же числом компонент или меньше) память не выделяется; один экземпляр - один поток
+class ComponentsWorkspace {
+public:
+    ComponentsWorkspace();
+    ~ComponentsWorkspace();
+
+    ComponentsWorkspace(const ComponentsWorkspace&) = delete;
+    ComponentsWorkspace& operator=(const ComponentsWorkspace&) = delete;
+
+private:
+    friend int connectedComponentStats(const cv::Mat&, cv::Mat&, cv::Mat&, ComponentsWorkspace&);
+    struct Buffers;
+    std::unique_ptr<Buffers> buffers_;
+};
+
+int connectedComponentStats(const cv::Mat& mask, cv::Mat& stats, cv::Mat& centroids, ComponentsWorkspace& workspace);
+
+#endif
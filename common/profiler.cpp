@@ -0,0 +1,188 @@
+#include "profiler.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+std::atomic<bool> StageProfiler::enabled_(false);
+
+namespace {
+
+// Логарифмические корзины: 8 на каждое удвоение, от 1 мкс до ~18 мин; погрешность перцентиля до 9%
+const double MIN_BUCKET_MS = 0.001;
+const int BUCKETS_PER_OCTAVE = 8;
+const int BUCKET_COUNT = 1 + 30 * BUCKETS_PER_OCTAVE;
+
+int bucketOf(double ms) {
+    if (!(ms > MIN_BUCKET_MS)) return 0;
+    int bucket = 1 + (int)(log2(ms / MIN_BUCKET_MS) * BUCKETS_PER_OCTAVE);
+    return min(bucket, BUCKET_COUNT - 1);
+}
+
+// Верхняя граница корзины
+double bucketLimit(int bucket) {
+    return MIN_BUCKET_MS * exp2((double)bucket / BUCKETS_PER_OCTAVE);
+}
+
+// Гистограмма этапа: память фиксирована и не растет с числом замеров
+struct StageHistogram {
+    const char* name = nullptr;
+    size_t count = 0;
+    double total_ms = 0.0;
+    double max_ms = 0.0;
+    size_t allocs = 0;
+    size_t alloc_bytes = 0;
+    array<uint64_t, BUCKET_COUNT> buckets{};
+
+    void merge(const StageHistogram& other) {
+        count += other.count;
+        total_ms += other.total_ms;
+        max_ms = max(max_ms, other.max_ms);
+        allocs += other.allocs;
+        alloc_bytes += other.alloc_bytes;
+        for (int i = 0; i < BUCKET_COUNT; ++i) buckets[i] += other.buckets[i];
+    }
+
+    // Перцентиль по ближайшему рангу: верхняя граница корзины, не больше максимума
+    double percentile(double p) const {
+        if (count == 0) return 0.0;
+        const uint64_t rank = max((uint64_t)ceil(p / 100.0 * count), (uint64_t)1);
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKET_COUNT; ++i) {
+            seen += buckets[i];
+            if (seen >= rank) return min(bucketLimit(i), max_ms);
+        }
+        return max_ms;
+    }
+};
+
+// Буфер одного потока; мьютекс берется без конкуренции, кроме момента сводки.
+// Этапы ищутся по адресу литерала, без построения строк
+struct ThreadSamples {
+    mutex lock;
+    vector<StageHistogram> stages;
+};
+
+mutex& registryLock() {
+    static mutex lock;
+    return lock;
+}
+
+// Буферы переживают свои потоки: пул batch-режима может завершиться раньше сводки
+vector<shared_ptr<ThreadSamples>>& registry() {
+    static vector<shared_ptr<ThreadSamples>> buffers;
+    return buffers;
+}
+
+ThreadSamples& threadSamples() {
+    thread_local shared_ptr<ThreadSamples> samples;
+    if (!samples) {
+        samples = make_shared<ThreadSamples>();
+        samples->stages.reserve(64);
+        lock_guard<mutex> guard(registryLock());
+        registry().push_back(samples);
+    }
+    return *samples;
+}
+
+} // namespace
+
+#ifdef TARGETLOCK_PROFILE_ALLOCS
+// Считаются аллокации через operator new (контейнеры и т.п.);
+// буферы cv::Mat выделяются через fastMalloc и сюда не попадают
+namespace {
+thread_local size_t tl_alloc_count = 0;
+thread_local size_t tl_alloc_bytes = 0;
+}
+
+void* operator new(size_t size) {
+    ++tl_alloc_count;
+    tl_alloc_bytes += size;
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+
+void* operator new[](size_t size) { return ::operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+bool StageProfiler::allocCountersEnabled() { return true; }
+size_t StageProfiler::threadAllocCount() { return tl_alloc_count; }
+size_t StageProfiler::threadAllocBytes() { return tl_alloc_bytes; }
+#else
+bool StageProfiler::allocCountersEnabled() { return false; }
+size_t StageProfiler::threadAllocCount() { return 0; }
+size_t StageProfiler::threadAllocBytes() { return 0; }
+#endif
+
+void StageProfiler::record(const char* stage, double ms, size_t allocs, size_t alloc_bytes) {
+    ThreadSamples& samples = threadSamples();
+    lock_guard<mutex> guard(samples.lock);
+    StageHistogram* h = nullptr;
+    for (auto& s : samples.stages) {
+        if (s.name == stage) {
+            h = &s;
+            break;
+        }
+    }
+    if (!h) {
+        samples.stages.emplace_back();
+        h = &samples.stages.back();
+        h->name = stage;
+    }
+    h->count++;
+    h->total_ms += ms;
+    h->max_ms = max(h->max_ms, ms);
+    h->buckets[bucketOf(ms)]++;
+    h->allocs += allocs;
+    h->alloc_bytes += alloc_bytes;
+}
+
+void StageProfiler::reset() {
+    lock_guard<mutex> guard(registryLock());
+    for (auto& buffer : registry()) {
+        lock_guard<mutex> buffer_guard(buffer->lock);
+        buffer->stages.clear();
+    }
+}
+
+void StageProfiler::writeJson(ostream& os) {
+    // Сводим буферы всех потоков; один этап может прийти из разных литералов с тем же текстом
+    map<string, StageHistogram> merged;
+    {
+        lock_guard<mutex> guard(registryLock());
+        for (auto& buffer : registry()) {
+            lock_guard<mutex> buffer_guard(buffer->lock);
+            for (const auto& stage : buffer->stages) merged[stage.name].merge(stage);
+        }
+    }
+
+    os << "{\n  \"alloc_counters\": " << (allocCountersEnabled() ? "true" : "false") << ",\n  \"stages\": [";
+    bool first = true;
+    for (const auto& entry : merged) {
+        const StageHistogram& h = entry.second;
+        os << (first ? "\n" : ",\n") << "    {\"name\": \"" << entry.first << "\""
+           << ", \"count\": " << h.count
+           << ", \"total_ms\": " << h.total_ms
+           << ", \"mean_ms\": " << (h.count == 0 ? 0.0 : h.total_ms / h.count)
+           << ", \"p50_ms\": " << h.percentile(50)
+           << ", \"p95_ms\": " << h.percentile(95)
+           << ", \"p99_ms\": " << h.percentile(99)
+           << ", \"max_ms\": " << h.max_ms
+           << ", \"allocs\": " << h.allocs
+           << ", \"alloc_bytes\": " << h.alloc_bytes << "}";
+        first = false;
+    }
+    os << (first ? "]\n}\n" : "\n  ]\n}\n");
+}
@@ -0,0 +1,71 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+
+// Встроенные замеры этапов анализа.
+// По умолчанию выключены: замер стоит одной атомарной загрузки флага.
+// С -DTARGETLOCK_DISABLE_PROFILING макрос TL_PROFILE_SCOPE вырезается при компиляции.
+// Счетчики аллокаций включаются опцией сборки TARGETLOCK_PROFILE_ALLOCS.
+class StageProfiler {
+public:
+    static void setEnabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // stage - строковый литерал (этап ищется по адресу); замер попадает в логарифмическую гистограмму потока
+    static void record(const char* stage, double ms, size_t allocs, size_t alloc_bytes);
+
+    static void reset();
+
+    // Сводка по всем потокам: count, total/mean/p50/p95/p99/max в мс, аллокации; перцентили - по корзинам, до 9%
+    static void writeJson(std::ostream& os);
+
+    // Счетчики аллокаций текущего потока (всегда 0 без TARGETLOCK_PROFILE_ALLOCS)
+    static bool allocCountersEnabled();
+    static size_t threadAllocCount();
+    static size_t threadAllocBytes();
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+class ScopedStageTimer {
+public:
+    explicit ScopedStageTimer(const char* stage) {
+        if (!StageProfiler::enabled()) return;
+        stage_ = stage;
+        allocs_ = StageProfiler::threadAllocCount();
+        alloc_bytes_ = StageProfiler::threadAllocBytes();
+        start_ = std::chrono::steady_clock::now();
+    }
+
+    ~ScopedStageTimer() {
+        if (!stage_) return;
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+        StageProfiler::record(stage_, ms, StageProfiler::threadAllocCount() - allocs_,
+            StageProfiler::threadAllocBytes() - alloc_bytes_);
+    }
+
+    ScopedStageTimer(const ScopedStageTimer&) = delete;
+    ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+private:
+    const char* stage_ = nullptr;
+    size_t allocs_ = 0;
+    size_t alloc_bytes_ = 0;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#define TL_PROFILE_CONCAT_(a, b) a##b
+#define TL_PROFILE_CONCAT(a, b) TL_PROFILE_CONCAT_(a, b)
+
+#ifdef TARGETLOCK_DISABLE_PROFILING
+#define TL_PROFILE_SCOPE(stage) ((void)0)
+#else
+#define TL_PROFILE_SCOPE(stage) ScopedStageTimer TL_PROFILE_CONCAT(tl_profile_scope_, __LINE__)(stage)
+#endif
+
+#endif
@@ -0,0 +1,94 @@
+#include "red_classifier.h"
+#include <opencv2/imgproc.hpp>
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+const int COLORS_PER_PLANE = 256 * 256;
+
+// Строит таблицу для плоскостей с фиксированным B: 256x256 цветов за вызов
+class BuildTableBody : public ParallelLoopBody {
+public:
+    BuildTableBody(const RedPixelClassifier& classifier, vector<uint64_t>& table)
+        : classifier_(classifier), table_(table) {}
+
+    void operator()(const Range& range) const override {
+        Mat plane(256, 256, CV_8UC3), mask;
+        for (int b = range.start; b < range.end; ++b) {
+            for (int g = 0; g < 256; ++g) {
+                Vec3b* row = plane.ptr<Vec3b>(g);
+                for (int r = 0; r < 256; ++r) {
+                    row[r] = Vec3b((uchar)b, (uchar)g, (uchar)r);
+                }
+            }
+
+            classifier_.classifyReference(plane, mask);
+
+            // Плоскость b занимает 1024 слова таблицы, потоки не пересекаются
+            uint64_t* words = &table_[(size_t)b * COLORS_PER_PLANE / 64];
+            for (int g = 0; g < 256; ++g) {
+                const uchar* m = mask.ptr<uchar>(g);
+                for (int r = 0; r < 256; ++r) {
+                    if (!m[r]) continue;
+                    int idx = (g << 8) | r;
+                    words[idx >> 6] |= uint64_t(1) << (idx & 63);
+                }
+            }
+        }
+    }
+
+private:
+    const RedPixelClassifier& classifier_;
+    vector<uint64_t>& table_;
+};
+
+class ClassifyBody : public ParallelLoopBody {
+public:
+    ClassifyBody(const RedPixelClassifier& classifier, const Mat& bgr, Mat& mask)
+        : classifier_(classifier), bgr_(bgr), mask_(mask) {}
+
+    void operator()(const Range& range) const override {
+        for (int y = range.start; y < range.end; ++y) {
+            const uchar* src = bgr_.ptr<uchar>(y);
+            uchar* dst = mask_.ptr<uchar>(y);
+            for (int x = 0; x < bgr_.cols; ++x, src += 3) {
+                dst[x] = classifier_.isRed(src[0], src[1], src[2]) ? 255 : 0;
+            }
+        }
+    }
+
+private:
+    const RedPixelClassifier& classifier_;
+    const Mat& bgr_;
+    Mat& mask_;
+};
+
+}
+
+RedPixelClassifier::RedPixelClassifier(const vector<HsvRange>& ranges) : ranges_(ranges) {
+    buildTable();
+}
+
+void RedPixelClassifier::buildTable() {
+    table_.assign((size_t)256 * COLORS_PER_PLANE / 64, 0);
+    parallel_for_(Range(0, 256), BuildTableBody(*this, table_));
+}
+
+void RedPixelClassifier::classify(const Mat& bgr, Mat& mask) const {
+    CV_Assert(bgr.type() == CV_8UC3);
+    mask.create(bgr.rows, bgr.cols, CV_8UC1);
+    parallel_for_(Range(0, bgr.rows), ClassifyBody(*this, bgr, mask));
+}
+
+void RedPixelClassifier::classifyReference(const Mat& bgr, Mat& mask) const {
+    Mat hsv, range_mask;
+    cvtColor(bgr, hsv, COLOR_BGR2HSV);
+
+    mask = Mat::zeros(bgr.rows, bgr.cols, CV_8UC1);
+    for (const auto& r : ranges_) {
+        inRange(hsv, r.lower, r.upper, range_mask);
+        bitwise_or(mask, range_mask, mask);
+    }
+}
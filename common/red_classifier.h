@@ -0,0 +1,40 @@
+#ifndef RED_CLASSIFIER_H
+#define RED_CLASSIFIER_H
+
+#include <opencv2/core.hpp>
+#include <vector>
+#include <cstdint>
+
+// Диапазон HSV в единицах OpenCV (H: 0..180, S, V: 0..255), границы включительно
+struct HsvRange {
+    cv::Scalar lower;
+    cv::Scalar upper;
+};
+
+// Классификатор красных пикселей: BGR -> бинарная маска за один проход.
+// Таблица на все 2^24 цвета строится один раз через cvtColor + inRange,
+// поэтому маска побитово совпадает с исходной цепочкой
+// cvtColor(BGR2HSV) + inRange + bitwise_or, но без HSV-копии и промежуточных масок.
+class RedPixelClassifier {
+public:
+    explicit RedPixelClassifier(const std::vector<HsvRange>& ranges);
+
+    // bgr - CV_8UC3, mask - CV_8UC1 (0 / 255)
+    void classify(const cv::Mat& bgr, cv::Mat& mask) const;
+
+    // Эталонная цепочка OpenCV с теми же диапазонами (для проверки и бенчмарка)
+    void classifyReference(const cv::Mat& bgr, cv::Mat& mask) const;
+
+    bool isRed(uchar b, uchar g, uchar r) const {
+        uint32_t idx = ((uint32_t)b << 16) | ((uint32_t)g << 8) | r;
+        return (table_[idx >> 6] >> (idx & 63)) & 1;
+    }
+
+private:
+    std::vector<HsvRange> ranges_;
+    std::vector<uint64_t> table_;   // 2^24 бит = 2 МБ
+
+    void buildTable();
+};
+
+#endif
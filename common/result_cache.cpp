@@ -0,0 +1,492 @@
+#include "result_cache.h"
+#include "content_hash.h"
+#include "logger.h"
+#include "../weapons/weapon_registry.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unordered_set>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+const char* RESULTS_FILE = "results.bin";
+const char* FILES_FILE = "files.bin";
+const size_t HEADER_SIZE = 8;
+const size_t RESULT_RECORD_OVERHEAD = 4 + 8 + 8;
+const size_t FILE_RECORD_OVERHEAD = 4 + 8 + 8 + 8;
+const uint32_t MAX_RECORD_SIZE = 16 << 20;
+
+bool isDirectory(const string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    return (st.st_mode & S_IFDIR) != 0;
+}
+
+bool makeDirectory(const string& path) {
+    if (isDirectory(path)) return true;
+#ifdef _WIN32
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+    return isDirectory(path);
+}
+
+string withSlash(const string& directory) {
+    if (directory.empty()) return "./";
+    if (directory.back() == '/' || directory.back() == '\\') return directory;
+    return directory + '/';
+}
+
+// Числа - в порядке байт машины, как в истории стрельб и двоичном формате результатов
+template <typename T>
+void put(string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Чтение с проверкой границ: после выхода за конец все get возвращают 0, ok() - false
+class Reader {
+public:
+    Reader(const unsigned char* data, size_t size) : p_(data), end_(data + size) {}
+
+    template <typename T>
+    T get() {
+        T value = T();
+        if ((size_t)(end_ - p_) < sizeof(T)) {
+            p_ = end_;
+            ok_ = false;
+            return value;
+        }
+        memcpy(&value, p_, sizeof(T));
+        p_ += sizeof(T);
+        return value;
+    }
+
+    bool bytes(size_t size, string& out) {
+        if ((size_t)(end_ - p_) < size) {
+            ok_ = false;
+            return false;
+        }
+        out.assign(reinterpret_cast<const char*>(p_), size);
+        p_ += size;
+        return true;
+    }
+
+    // Число элементов по size байт; false, если столько не помещается в остаток
+    bool count(size_t size, uint32_t& n) {
+        n = get<uint32_t>();
+        if (!ok_ || (uint64_t)n * size > (uint64_t)(end_ - p_)) ok_ = false;
+        return ok_;
+    }
+
+    bool ok() const { return ok_; }
+    bool atEnd() const { return p_ == end_; }
+
+private:
+    const unsigned char* p_;
+    const unsigned char* end_;
+    bool ok_ = true;
+};
+
+// Результат без пути: путь у каждого запроса свой
+string serializeResult(const BatchItemResult& result) {
+    string out;
+    out.reserve(96 + result.error.size() + result.holes.size() * 8 + result.detections.size() * 12);
+    put<uint8_t>(out, result.ok ? 1 : 0);
+    put<double>(out, result.pixels_per_cm);
+    put<int32_t>(out, result.decode_reduction);
+    put<uint32_t>(out, (uint32_t)result.error.size());
+    out += result.error;
+
+    put<uint32_t>(out, (uint32_t)result.holes.size());
+    for (const auto& h : result.holes) {
+        put<float>(out, h.x);
+        put<float>(out, h.y);
+    }
+    put<uint32_t>(out, (uint32_t)result.detections.size());
+    for (const auto& d : result.detections) {
+        put<float>(out, d.center.x);
+        put<float>(out, d.center.y);
+        put<int32_t>(out, d.pixel_count);
+    }
+
+    const ShootingMetrics& m = result.metrics;
+    put<double>(out, m.precision);
+    put<double>(out, m.group_radius);
+    put<float>(out, m.stp.x);
+    put<float>(out, m.stp.y);
+    put<double>(out, m.precision_cm);
+    put<double>(out, m.group_radius_cm);
+    put<double>(out, m.distance_to_center_cm);
+    put<float>(out, m.target_center.x);
+    put<float>(out, m.target_center.y);
+    return out;
+}
+
+bool deserializeResult(const string& payload, BatchItemResult& result) {
+    Reader in(reinterpret_cast<const unsigned char*>(payload.data()), payload.size());
+    result.ok = in.get<uint8_t>() != 0;
+    result.pixels_per_cm = in.get<double>();
+    result.decode_reduction = in.get<int32_t>();
+
+    uint32_t n;
+    if (!in.count(1, n) || !in.bytes(n, result.error)) return false;
+
+    if (!in.count(8, n)) return false;
+    result.holes.resize(n);
+    for (auto& h : result.holes) {
+        h.x = in.get<float>();
+        h.y = in.get<float>();
+    }
+    if (!in.count(12, n)) return false;
+    result.detections.resize(n);
+    for (auto& d : result.detections) {
+        d.center.x = in.get<float>();
+        d.center.y = in.get<float>();
+        d.pixel_count = in.get<int32_t>();
+    }
+
+    ShootingMetrics& m = result.metrics;
+    m.precision = in.get<double>();
+    m.group_radius = in.get<double>();
+    m.stp.x = in.get<float>();
+    m.stp.y = in.get<float>();
+    m.precision_cm = in.get<double>();
+    m.group_radius_cm = in.get<double>();
+    m.distance_to_center_cm = in.get<double>();
+    m.target_center.x = in.get<float>();
+    m.target_center.y = in.get<float>();
+    return in.ok() && in.atEnd();
+}
+
+bool readWholeFile(const string& path, vector<unsigned char>& data) {
+    ifstream in(path, ios::binary | ios::ate);
+    if (!in) return false;
+    const streamoff size = in.tellg();
+    data.resize((size_t)max<streamoff>(size, 0));
+    in.seekg(0);
+    return data.empty() || (bool)in.read(reinterpret_cast<char*>(data.data()), (streamsize)data.size());
+}
+
+string fileHeader(const char* magic) {
+    string header(magic, 4);
+    put<uint32_t>(header, RESULT_CACHE_VERSION);
+    return header;
+}
+
+bool replaceFile(const string& from, const string& to) {
+#ifdef _WIN32
+    remove(to.c_str());
+#endif
+    return rename(from.c_str(), to.c_str()) == 0;
+}
+
+}
+
+uint64_t analysisParameterHash(const BatchOptions& options) {
+    ParameterHasher h;
+    h.add((uint64_t)RESULT_CACHE_VERSION).add(weaponParameterHash(options.weapon));
+    h.add(options.coarse_to_fine).add(options.hook_zone_first);
+    h.add(options.target_pixels_per_cm).add(options.sheets_across);
+    return h.value();
+}
+
+bool statFile(const string& path, FileStamp& stamp) {
+    stamp.path = path;
+    stamp.size = -1;
+    stamp.mtime_ns = 0;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || (st.st_mode & S_IFDIR) != 0) return false;
+
+    stamp.size = (int64_t)st.st_size;
+#if defined(__APPLE__)
+    stamp.mtime_ns = (int64_t)st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+    stamp.mtime_ns = (int64_t)st.st_mtime * 1000000000LL;
+#else
+    stamp.mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
+bool ResultCache::open(const string& directory, size_t max_bytes, string* error) {
+    close();
+    if (!makeDirectory(directory)) {
+        if (error) *error = "cannot create " + directory;
+        return false;
+    }
+    directory_ = withSlash(directory);
+    max_bytes_ = max_bytes;
+
+    // Файлы другой версии или с оборванным хвостом переписываются из того, что удалось прочитать
+    lock_guard<mutex> guard(lock_);
+    const bool results_intact = loadResults(directory_ + RESULTS_FILE);
+    const bool files_intact = loadFiles(directory_ + FILES_FILE);
+    if (!results_intact || !files_intact || results_file_bytes_ > live_bytes_ + HEADER_SIZE) {
+        if (!compactLocked()) {
+            if (error) *error = "cannot write " + directory_ + RESULTS_FILE;
+            return false;
+        }
+    } else {
+        results_out_.open(directory_ + RESULTS_FILE, ios::binary | ios::app);
+        files_out_.open(directory_ + FILES_FILE, ios::binary | ios::app);
+        if (!results_out_ || !files_out_) {
+            if (error) *error = "cannot write " + directory_;
+            return false;
+        }
+    }
+
+    open_ = true;
+    TL_LOG_INFO("Result cache " << directory << ": " << entries_.size() << " results, " << files_.size()
+        << " files, " << live_bytes_ / 1024 << " KB");
+    return true;
+}
+
+void ResultCache::close() {
+    lock_guard<mutex> guard(lock_);
+
+    // Вытесненные и замененные записи остаются в файлах до уплотнения
+    const bool dead_results = results_file_bytes_ > live_bytes_ + HEADER_SIZE;
+    const bool dead_files = files_file_bytes_ > files_live_bytes_ + HEADER_SIZE;
+    if (open_ && (dead_results || dead_files)) compactLocked();
+
+    results_out_.close();
+    files_out_.close();
+    lru_.clear();
+    entries_.clear();
+    files_.clear();
+    live_bytes_ = 0;
+    files_live_bytes_ = 0;
+    results_file_bytes_ = 0;
+    files_file_bytes_ = 0;
+    open_ = false;
+}
+
+void ResultCache::flush() {
+    lock_guard<mutex> guard(lock_);
+    results_out_.flush();
+    files_out_.flush();
+}
+
+size_t ResultCache::bytes() const {
+    lock_guard<mutex> guard(lock_);
+    return live_bytes_;
+}
+
+bool ResultCache::lookupFile(const string& path, uint64_t params, BatchItemResult& result, FileStamp& stamp) {
+    if (!statFile(path, stamp)) return false;
+
+    lock_guard<mutex> guard(lock_);
+    auto file = files_.find(path);
+    if (file == files_.end() || file->second.size != stamp.size || file->second.mtime_ns != stamp.mtime_ns) {
+        return false;
+    }
+    Key key = { file->second.content, params };
+    return findLocked(key, result);
+}
+
+bool ResultCache::lookup(const FileStamp& stamp, uint64_t content, uint64_t params, BatchItemResult& result) {
+    lock_guard<mutex> guard(lock_);
+    Key key = { content, params };
+    if (!findLocked(key, result)) return false;
+    rememberFileLocked(stamp, content);
+    return true;
+}
+
+void ResultCache::store(const FileStamp& stamp, uint64_t content, uint64_t params, const BatchItemResult& result) {
+    string payload = serializeResult(result);
+    misses_++;
+
+    lock_guard<mutex> guard(lock_);
+    if (!open_) return;
+    Key key = { content, params };
+    appendResult(key, payload);
+    insertLocked(key, move(payload));
+    rememberFileLocked(stamp, content);
+
+    if (results_file_bytes_ > 2 * (uint64_t)max_bytes_ + HEADER_SIZE ||
+        files_file_bytes_ > 2 * files_live_bytes_ + (1 << 20)) {
+        compactLocked();
+    }
+}
+
+bool ResultCache::findLocked(const Key& key, BatchItemResult& result) {
+    auto it = entries_.find(key);
+    if (it == entries_.end()) return false;
+
+    // Путь результата - от запроса
+    string path = move(result.path);
+    if (!deserializeResult(it->second->payload, result)) {
+        result = BatchItemResult();
+        result.path = move(path);
+        return false;
+    }
+    result.path = move(path);
+    lru_.splice(lru_.begin(), lru_, it->second);
+    hits_++;
+    return true;
+}
+
+void ResultCache::rememberFileLocked(const FileStamp& stamp, uint64_t content) {
+    if (stamp.size < 0) return;
+    FileEntry file = { stamp.size, stamp.mtime_ns, content };
+    auto it = files_.find(stamp.path);
+    if (it != files_.end()) {
+        if (it->second.size == file.size && it->second.mtime_ns == file.mtime_ns && it->second.content == content) {
+            return;
+        }
+        it->second = file;
+    } else {
+        files_.emplace(stamp.path, file);
+        files_live_bytes_ += FILE_RECORD_OVERHEAD + stamp.path.size();
+    }
+    appendFile(stamp.path, file);
+}
+
+void ResultCache::insertLocked(const Key& key, string payload) {
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+        live_bytes_ -= RESULT_RECORD_OVERHEAD + it->second->payload.size();
+        lru_.erase(it->second);
+        entries_.erase(it);
+    }
+
+    live_bytes_ += RESULT_RECORD_OVERHEAD + payload.size();
+    lru_.push_front(Entry{ key, move(payload) });
+    entries_[key] = lru_.begin();
+
+    // Последний результат остается даже сверх предела
+    while (live_bytes_ > max_bytes_ && lru_.size() > 1) {
+        const Entry& oldest = lru_.back();
+        live_bytes_ -= RESULT_RECORD_OVERHEAD + oldest.payload.size();
+        entries_.erase(oldest.key);
+        lru_.pop_back();
+    }
+}
+
+void ResultCache::appendResult(const Key& key, const string& payload) {
+    string record;
+    put<uint32_t>(record, (uint32_t)payload.size());
+    put<uint64_t>(record, key.content);
+    put<uint64_t>(record, key.params);
+    record += payload;
+    results_out_.write(record.data(), (streamsize)record.size());
+    results_file_bytes_ += record.size();
+}
+
+void ResultCache::appendFile(const string& path, const FileEntry& file) {
+    string record;
+    put<uint32_t>(record, (uint32_t)path.size());
+    record += path;
+    put<int64_t>(record, file.size);
+    put<int64_t>(record, file.mtime_ns);
+    put<uint64_t>(record, file.content);
+    files_out_.write(record.data(), (streamsize)record.size());
+    files_file_bytes_ += record.size();
+}
+
+// false - файл нужно переписать: чужой заголовок или оборванная запись в конце
+bool ResultCache::loadResults(const string& path) {
+    results_file_bytes_ = 0;
+    vector<unsigned char> data;
+    if (!readWholeFile(path, data)) return false;
+    const string header = fileHeader("TLRC");
+    if (data.size() < HEADER_SIZE || memcmp(data.data(), header.data(), HEADER_SIZE) != 0) return false;
+
+    // Записи идут от старых к новым: каждая следующая становится последней использованной
+    Reader in(data.data() + HEADER_SIZE, data.size() - HEADER_SIZE);
+    size_t offset = HEADER_SIZE;
+    while (!in.atEnd()) {
+        uint32_t size;
+        if (!in.count(1, size) || size > MAX_RECORD_SIZE) return false;
+        Key key;
+        key.content = in.get<uint64_t>();
+        key.params = in.get<uint64_t>();
+        string payload;
+        if (!in.bytes(size, payload)) return false;
+        insertLocked(key, move(payload));
+        offset += RESULT_RECORD_OVERHEAD + size;
+    }
+    results_file_bytes_ = offset;
+    return true;
+}
+
+bool ResultCache::loadFiles(const string& path) {
+    files_file_bytes_ = 0;
+    vector<unsigned char> data;
+    if (!readWholeFile(path, data)) return false;
+    const string header = fileHeader("TLRF");
+    if (data.size() < HEADER_SIZE || memcmp(data.data(), header.data(), HEADER_SIZE) != 0) return false;
+
+    Reader in(data.data() + HEADER_SIZE, data.size() - HEADER_SIZE);
+    size_t offset = HEADER_SIZE;
+    while (!in.atEnd()) {
+        uint32_t length;
+        string file_path;
+        if (!in.count(1, length) || !in.bytes(length, file_path)) return false;
+        FileEntry file;
+        file.size = in.get<int64_t>();
+        file.mtime_ns = in.get<int64_t>();
+        file.content = in.get<uint64_t>();
+        if (!in.ok()) return false;
+
+        auto inserted = files_.emplace(file_path, file);
+        if (inserted.second) files_live_bytes_ += FILE_RECORD_OVERHEAD + file_path.size();
+        else inserted.first->second = file;
+        offset += FILE_RECORD_OVERHEAD + length;
+    }
+    files_file_bytes_ = offset;
+    return true;
+}
+
+// Перезапись обоих файлов из памяти: результаты от давних к последним, пути - только к живым результатам.
+// Новые файлы пишутся рядом и заменяют старые переименованием
+bool ResultCache::compactLocked() {
+    results_out_.close();
+    files_out_.close();
+
+    unordered_set<uint64_t> contents;
+    for (const auto& entry : lru_) contents.insert(entry.key.content);
+    for (auto it = files_.begin(); it != files_.end();) {
+        if (contents.count(it->second.content)) {
+            ++it;
+        } else {
+            files_live_bytes_ -= FILE_RECORD_OVERHEAD + it->first.size();
+            it = files_.erase(it);
+        }
+    }
+
+    const string results_path = directory_ + RESULTS_FILE;
+    const string files_path = directory_ + FILES_FILE;
+    results_out_.open(results_path + ".tmp", ios::binary | ios::trunc);
+    files_out_.open(files_path + ".tmp", ios::binary | ios::trunc);
+    const string results_header = fileHeader("TLRC");
+    const string files_header = fileHeader("TLRF");
+    results_out_.write(results_header.data(), (streamsize)results_header.size());
+    files_out_.write(files_header.data(), (streamsize)files_header.size());
+    results_file_bytes_ = HEADER_SIZE;
+    files_file_bytes_ = HEADER_SIZE;
+
+    for (auto it = lru_.rbegin(); it != lru_.rend(); ++it) appendResult(it->key, it->payload);
+    for (const auto& file : files_) appendFile(file.first, file.second);
+
+    const bool written = (bool)results_out_ && (bool)files_out_;
+    results_out_.close();
+    files_out_.close();
+    const bool replaced = written && replaceFile(results_path + ".tmp", results_path) &&
+        replaceFile(files_path + ".tmp", files_path);
+    if (!replaced) TL_LOG_WARNING("Cannot compact result cache " << directory_);
+
+    results_out_.open(results_path, ios::binary | ios::app);
+    files_out_.open(files_path, ios::binary | ios::app);
+    return replaced && (bool)results_out_ && (bool)files_out_;
+}
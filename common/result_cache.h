@@ -0,0 +1,124 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "batch_processor.h"
+
+// Кэш результатов анализа на диске для повторных прогонов архивов.
+//
+// Ключ - хеш содержимого снимка (XXH64) и отпечаток параметров анализа (analysisParameterHash):
+// пороги HSV, площади кластеров, радиус объединения, зона крючков и остальные константы профиля,
+// режимы детекции и масштаб декодирования. Значение - пробоины, кандидаты детектора (DetectedHole)
+// и метрики; при попадании снимок не читается и не декодируется.
+//
+// Второй индекс - путь -> (размер, время изменения, хеш содержимого): неизменный файл находится
+// одним stat без открытия, это дешевле разбора заголовка JPEG. Переименованный или скопированный
+// файл находится по хешу содержимого, без декодирования.
+//
+// Каталог:
+//   results.bin   "TLRC", версия (u32), затем записи: u32 длина, u64 хеш содержимого, u64 параметры, результат
+//   files.bin     "TLRF", версия (u32), затем записи: u32 длина пути, путь, i64 размер, i64 mtime (нс), u64 хеш
+// Файлы только дописываются; недописанный хвост после сбоя отбрасывается при открытии.
+// Весь кэш в памяти, объем результатов ограничен max_bytes: вытесняются давно не использованные (LRU).
+// Вытесненные и замененные записи удаляются с диска уплотнением - при close() и при росте файла
+// результатов вдвое выше предела; уплотнение сохраняет и порядок LRU.
+//
+// Потокобезопасен. Результаты с калибровкой линии не кэшируются: они зависят от снимка, по которому
+// калибровалась линия (BatchProcessor и конвейер обходят кэш при BatchOptions::calibration).
+
+// Версия формата и алгоритмов анализа: меняется вместе с детектором, чтобы старые записи не совпадали
+const uint32_t RESULT_CACHE_VERSION = 2;
+
+// Отпечаток параметров, от которых зависит результат снимка
+uint64_t analysisParameterHash(const BatchOptions& options);
+
+// Состояние файла на момент stat
+struct FileStamp {
+    std::string path;
+    int64_t size = -1;          // -1 - stat не удался
+    int64_t mtime_ns = 0;
+};
+
+bool statFile(const std::string& path, FileStamp& stamp);
+
+class ResultCache {
+public:
+    ResultCache() {}
+    ~ResultCache() { close(); }
+
+    // Каталог создается, если его нет
+    bool open(const std::string& directory, size_t max_bytes = 256 << 20, std::string* error = nullptr);
+    void close();
+    void flush();
+
+    bool isOpen() const { return open_; }
+
+    // По пути без чтения файла; stamp заполняется для последующих lookup/store
+    bool lookupFile(const std::string& path, uint64_t params, BatchItemResult& result, FileStamp& stamp);
+
+    // По содержимому; при попадании путь из stamp запоминается для следующих lookupFile
+    bool lookup(const FileStamp& stamp, uint64_t content, uint64_t params, BatchItemResult& result);
+
+    // Результат анализа (path не сохраняется); stamp.size < 0 - снимок не из файла
+    void store(const FileStamp& stamp, uint64_t content, uint64_t params, const BatchItemResult& result);
+
+    size_t hits() const { return hits_; }          // результатов из кэша
+    size_t misses() const { return misses_; }      // сохраненных после анализа
+    size_t bytes() const;                          // объем живых результатов
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+private:
+    struct Key {
+        uint64_t content;
+        uint64_t params;
+        bool operator==(const Key& other) const { return content == other.content && params == other.params; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const { return (size_t)(key.content ^ (key.params * 0x9E3779B97F4A7C15ULL)); }
+    };
+    struct Entry {
+        Key key;
+        std::string payload;
+    };
+    struct FileEntry {
+        int64_t size;
+        int64_t mtime_ns;
+        uint64_t content;
+    };
+
+    bool findLocked(const Key& key, BatchItemResult& result);
+    void rememberFileLocked(const FileStamp& stamp, uint64_t content);
+    void insertLocked(const Key& key, std::string payload);
+    void appendResult(const Key& key, const std::string& payload);
+    void appendFile(const std::string& path, const FileEntry& file);
+    bool loadResults(const std::string& path);
+    bool loadFiles(const std::string& path);
+    bool compactLocked();
+
+    std::string directory_;
+    bool open_ = false;
+    size_t max_bytes_ = 0;
+    mutable std::mutex lock_;
+
+    // Начало списка - последние использованные
+    std::list<Entry> lru_;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> entries_;
+    std::unordered_map<std::string, FileEntry> files_;
+    size_t live_bytes_ = 0;                 // записи results.bin живых результатов
+    uint64_t files_live_bytes_ = 0;         // записи files.bin живых путей
+    uint64_t results_file_bytes_ = 0, files_file_bytes_ = 0;
+    std::ofstream results_out_, files_out_;
+    std::atomic<size_t> hits_{ 0 }, misses_{ 0 };
+};
+
+#endif
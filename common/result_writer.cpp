@@ -0,0 +1,194 @@
+#include "result_writer.h"
+#include <cstdio>
+#include <cstring>
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+const size_t FILE_BUFFER_SIZE = 1 << 20;
+
+void appendf(string& out, const char* format, double value) {
+    char buf[64];
+    int n = snprintf(buf, sizeof(buf), format, value);
+    if (n > 0) out.append(buf, (size_t)min(n, (int)sizeof(buf) - 1));
+}
+
+void appendJsonString(string& out, const string& s) {
+    out += '"';
+    for (unsigned char c : s) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20) appendf(out, "\\u%04x", c);
+            else out += (char)c;
+        }
+    }
+    out += '"';
+}
+
+void appendCsvString(string& out, const string& s) {
+    if (s.find_first_of(",\"\n\r") == string::npos) {
+        out += s;
+        return;
+    }
+    out += '"';
+    for (char c : s) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    out += '"';
+}
+
+string jsonRecord(size_t index, const BatchItemResult& r) {
+    const ShootingMetrics& m = r.metrics;
+    string out = "{\"index\":" + to_string(index) + ",\"path\":";
+    appendJsonString(out, r.path);
+    out += r.ok ? ",\"ok\":true" : ",\"ok\":false";
+    if (!r.ok) {
+        out += ",\"error\":";
+        appendJsonString(out, r.error);
+        out += "}\n";
+        return out;
+    }
+
+    out += ",\"pixels_per_cm\":"; appendf(out, "%.3f", r.pixels_per_cm);
+    out += ",\"decode_reduction\":" + to_string(r.decode_reduction);
+    out += ",\"stp\":["; appendf(out, "%.2f", m.stp.x); out += ','; appendf(out, "%.2f", m.stp.y); out += ']';
+    out += ",\"precision_cm\":"; appendf(out, "%.2f", m.precision_cm);
+    out += ",\"group_radius_cm\":"; appendf(out, "%.2f", m.group_radius_cm);
+    out += ",\"distance_to_center_cm\":"; appendf(out, "%.2f", m.distance_to_center_cm);
+    out += ",\"target_center\":["; appendf(out, "%.2f", m.target_center.x); out += ',';
+    appendf(out, "%.2f", m.target_center.y); out += ']';
+    out += ",\"holes\":[";
+    for (size_t i = 0; i < r.holes.size(); ++i) {
+        if (i) out += ',';
+        out += '['; appendf(out, "%.2f", r.holes[i].x); out += ','; appendf(out, "%.2f", r.holes[i].y); out += ']';
+    }
+    out += "]}\n";
+    return out;
+}
+
+const char* CSV_HEADER = "index,path,ok,error,pixels_per_cm,decode_reduction,stp_x,stp_y,precision_cm,"
+                         "group_radius_cm,distance_to_center_cm,target_x,target_y,shots,holes\n";
+
+string csvRecord(size_t index, const BatchItemResult& r) {
+    const ShootingMetrics& m = r.metrics;
+    string out = to_string(index) + ",";
+    appendCsvString(out, r.path);
+    out += r.ok ? ",1," : ",0,";
+    appendCsvString(out, r.error);
+    if (!r.ok) {
+        out += ",,,,,,,,,,0,\n";
+        return out;
+    }
+
+    out += ','; appendf(out, "%.3f", r.pixels_per_cm);
+    out += ',' + to_string(r.decode_reduction);
+    out += ','; appendf(out, "%.2f", m.stp.x);
+    out += ','; appendf(out, "%.2f", m.stp.y);
+    out += ','; appendf(out, "%.2f", m.precision_cm);
+    out += ','; appendf(out, "%.2f", m.group_radius_cm);
+    out += ','; appendf(out, "%.2f", m.distance_to_center_cm);
+    out += ','; appendf(out, "%.2f", m.target_center.x);
+    out += ','; appendf(out, "%.2f", m.target_center.y);
+    out += ',' + to_string(r.holes.size()) + ',';
+    for (size_t i = 0; i < r.holes.size(); ++i) {
+        if (i) out += ';';
+        appendf(out, "%.2f", r.holes[i].x); out += ' '; appendf(out, "%.2f", r.holes[i].y);
+    }
+    out += '\n';
+    return out;
+}
+
+// Числа пишутся в порядке байт машины; поддерживаемые платформы - little-endian
+template <typename T>
+void put(char*& p, T value) {
+    memcpy(p, &value, sizeof(T));
+    p += sizeof(T);
+}
+
+string binaryRecord(size_t index, const BatchItemResult& r) {
+    string out(BINARY_RECORD_SIZE, '\0');
+    char* p = &out[0];
+    const ShootingMetrics& m = r.metrics;
+    const int shots = r.ok ? min((int)r.holes.size(), BINARY_MAX_SHOTS) : 0;
+
+    put<uint32_t>(p, (uint32_t)index);
+    put<uint8_t>(p, r.ok ? 1 : 0);
+    put<uint8_t>(p, (uint8_t)shots);
+    put<uint16_t>(p, (uint16_t)r.decode_reduction);
+    put<float>(p, (float)r.pixels_per_cm);
+    if (!r.ok) return out;
+
+    put<float>(p, m.stp.x);
+    put<float>(p, m.stp.y);
+    put<float>(p, (float)m.precision_cm);
+    put<float>(p, (float)m.group_radius_cm);
+    put<float>(p, (float)m.distance_to_center_cm);
+    put<float>(p, m.target_center.x);
+    put<float>(p, m.target_center.y);
+    for (int i = 0; i < shots; ++i) {
+        put<float>(p, r.holes[i].x);
+        put<float>(p, r.holes[i].y);
+    }
+    return out;
+}
+
+} // namespace
+
+bool parseResultFormat(const string& name, ResultFormat& format) {
+    if (name == "jsonl" || name == "json") format = ResultFormat::JsonLines;
+    else if (name == "csv") format = ResultFormat::Csv;
+    else if (name == "bin" || name == "binary") format = ResultFormat::Binary;
+    else return false;
+    return true;
+}
+
+string ResultWriter::formatRecord(ResultFormat format, size_t index, const BatchItemResult& result) {
+    switch (format) {
+    case ResultFormat::Csv: return csvRecord(index, result);
+    case ResultFormat::Binary: return binaryRecord(index, result);
+    default: return jsonRecord(index, result);
+    }
+}
+
+bool ResultWriter::open(const string& path, ResultFormat format) {
+    close();
+    format_ = format;
+
+    // Крупный буфер файла: запись на диск - пачками, а не на каждую строку
+    buffer_.resize(FILE_BUFFER_SIZE);
+    out_.rdbuf()->pubsetbuf(buffer_.data(), (streamsize)buffer_.size());
+    out_.open(path, ios::out | ios::binary | ios::trunc);
+    if (!out_) return false;
+
+    if (format_ == ResultFormat::Csv) {
+        out_ << CSV_HEADER;
+    } else if (format_ == ResultFormat::Binary) {
+        char header[12];
+        char* p = header;
+        memcpy(p, "TLRB", 4);
+        p += 4;
+        put<uint32_t>(p, BINARY_RESULT_VERSION);
+        put<uint32_t>(p, (uint32_t)BINARY_RECORD_SIZE);
+        out_.write(header, sizeof(header));
+    }
+    return (bool)out_;
+}
+
+void ResultWriter::write(size_t index, const BatchItemResult& result) {
+    const string record = formatRecord(format_, index, result);
+    lock_guard<mutex> guard(lock_);
+    if (out_.is_open()) out_.write(record.data(), (streamsize)record.size());
+}
+
+void ResultWriter::close() {
+    lock_guard<mutex> guard(lock_);
+    if (out_.is_open()) out_.close();
+}
@@ -0,0 +1,54 @@
+#ifndef RESULT_WRITER_H
+#define RESULT_WRITER_H
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "batch_processor.h"
+
+enum class ResultFormat {
+    JsonLines,      // одна JSON-строка на снимок
+    Csv,            // заголовок + строка на снимок, пробоины "x y;x y;..."
+    Binary          // заголовок файла + записи фиксированной длины (little-endian)
+};
+
+// "jsonl", "csv", "bin"
+bool parseResultFormat(const std::string& name, ResultFormat& format);
+
+// Двоичный формат: заголовок "TLRB", версия (u32), размер записи (u32), затем записи:
+//   u32 index, u8 ok, u8 shots, u16 decode_reduction, f32 pixels_per_cm,
+//   f32 stp.x, stp.y, precision_cm, group_radius_cm, distance_to_center_cm, target_center.x, target_center.y,
+//   BINARY_MAX_SHOTS x (f32 x, f32 y) - неиспользуемые слоты заполнены нулями.
+// Путь в запись не входит: index - позиция во входном списке.
+const uint32_t BINARY_RESULT_VERSION = 1;
+const int BINARY_MAX_SHOTS = 10;
+const size_t BINARY_RECORD_SIZE = 4 + 4 + 4 + 7 * 4 + BINARY_MAX_SHOTS * 8;
+
+// Потоковая запись результатов. write() можно вызывать из нескольких потоков:
+// запись форматируется без блокировки, под мьютексом только дописывается в буферизованный файл.
+class ResultWriter {
+public:
+    ResultWriter() {}
+    ~ResultWriter() { close(); }
+
+    bool open(const std::string& path, ResultFormat format);
+    void write(size_t index, const BatchItemResult& result);
+    void close();
+
+    bool isOpen() const { return out_.is_open(); }
+
+    static std::string formatRecord(ResultFormat format, size_t index, const BatchItemResult& result);
+
+    ResultWriter(const ResultWriter&) = delete;
+    ResultWriter& operator=(const ResultWriter&) = delete;
+
+private:
+    std::vector<char> buffer_;
+    std::ofstream out_;
+    ResultFormat format_ = ResultFormat::JsonLines;
+    std::mutex lock_;
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef ROI_UTILS_H
+#define ROI_UTILS_H
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+// Сливает пересекающиеся прямоугольники, чтобы каждая точка сканировалась один раз
+inline void mergeOverlappingRects(std::vector<cv::Rect>& rects) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < rects.size() && !changed; ++i) {
+            for (size_t j = i + 1; j < rects.size(); ++j) {
+                if ((rects[i] & rects[j]).area() > 0) {
+                    rects[i] |= rects[j];
+                    rects.erase(rects.begin() + j);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// Компонента упирается во внутреннюю границу окна (не в край кадра) - значит, она обрезана
+inline bool touchesInnerBorder(const cv::Rect& bbox, const cv::Rect& window, const cv::Size& frame) {
+    return (bbox.x == window.x && window.x > 0) ||
+        (bbox.y == window.y && window.y > 0) ||
+        (bbox.br().x == window.br().x && window.br().x < frame.width) ||
+        (bbox.br().y == window.br().y && window.br().y < frame.height);
+}
+
+#endif
@@ -0,0 +1,190 @@
+#include "sheet_calibration.h"
+#include <opencv2/imgproc.hpp>
+#include "profiler.h"
+#include "logger.h"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+const double A3_SHORT_CM = 30.0;
+const double A3_LONG_CM = 42.0;
+
+// Углы листа ищутся на копии с такой длинной стороной
+const int DETECT_MAX_SIDE = 1000;
+
+// TL, TR, BR, BL по сумме и разности координат
+void orderCorners(const vector<Point>& quad, double scale, Point2f corners[4]) {
+    int tl = 0, tr = 0, br = 0, bl = 0;
+    for (int i = 1; i < 4; ++i) {
+        if (quad[i].x + quad[i].y < quad[tl].x + quad[tl].y) tl = i;
+        if (quad[i].x + quad[i].y > quad[br].x + quad[br].y) br = i;
+        if (quad[i].x - quad[i].y > quad[tr].x - quad[tr].y) tr = i;
+        if (quad[i].x - quad[i].y < quad[bl].x - quad[bl].y) bl = i;
+    }
+    const int order[4] = { tl, tr, br, bl };
+    for (int i = 0; i < 4; ++i) {
+        corners[i] = Point2f((float)(quad[order[i]].x * scale), (float)(quad[order[i]].y * scale));
+    }
+}
+
+double distance(const Point2f& a, const Point2f& b) {
+    return norm(a - b);
+}
+
+} // namespace
+
+bool detectSheetCorners(const Mat& image, Point2f corners[4]) {
+    TL_PROFILE_SCOPE("sheet_corners");
+
+    // Лист - самая крупная светлая область; достаточно уменьшенной копии
+    const double scale = max(1.0, (double)max(image.cols, image.rows) / DETECT_MAX_SIDE);
+    Mat small, gray, binary;
+    resize(image, small, Size(cvRound(image.cols / scale), cvRound(image.rows / scale)), 0, 0, INTER_AREA);
+    cvtColor(small, gray, COLOR_BGR2GRAY);
+    GaussianBlur(gray, gray, Size(5, 5), 0);
+    threshold(gray, binary, 0, 255, THRESH_BINARY | THRESH_OTSU);
+
+    // Закрываем пробоины и наклейки, чтобы контур листа был сплошным
+    Mat kernel = getStructuringElement(MORPH_RECT, Size(7, 7));
+    morphologyEx(binary, binary, MORPH_CLOSE, kernel);
+
+    vector<vector<Point>> contours;
+    findContours(binary, contours, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
+
+    int best = -1;
+    double best_area = 0;
+    for (size_t i = 0; i < contours.size(); ++i) {
+        double area = contourArea(contours[i]);
+        if (area > best_area) {
+            best_area = area;
+            best = (int)i;
+        }
+    }
+    if (best < 0 || best_area < 0.2 * small.cols * small.rows) return false;
+
+    vector<Point> quad;
+    approxPolyDP(contours[best], quad, 0.02 * arcLength(contours[best], true), true);
+    if (quad.size() != 4 || !isContourConvex(quad)) return false;
+
+    orderCorners(quad, scale, corners);
+    return true;
+}
+
+SheetCalibration calibrateSheet(const Mat& image, double canonical_px_per_cm) {
+    SheetCalibration cal;
+    cal.source_size = image.size();
+    cal.pixels_per_cm = canonical_px_per_cm;
+
+    cal.sheet_found = detectSheetCorners(image, cal.corners);
+    if (!cal.sheet_found) {
+        // Прежнее допущение: лист занимает весь кадр
+        cal.corners[0] = Point2f(0, 0);
+        cal.corners[1] = Point2f((float)image.cols, 0);
+        cal.corners[2] = Point2f((float)image.cols, (float)image.rows);
+        cal.corners[3] = Point2f(0, (float)image.rows);
+        TL_LOG_WARNING("Sheet corners not found, assuming the sheet fills the frame");
+    }
+
+    Point2f src[4];
+    copy(cal.corners, cal.corners + 4, src);
+    double width_px = (distance(src[0], src[1]) + distance(src[3], src[2])) / 2.0;
+    double height_px = (distance(src[0], src[3]) + distance(src[1], src[2])) / 2.0;
+
+    // Лист всегда выпрямляется вертикально. В горизонтальном кадре верх листа
+    // считается у левого края (камера повернута по часовой стрелке). Без найденных углов
+    // кадр не поворачивается: как и без калибровки, верх снимка - верх листа
+    if (cal.sheet_found && width_px > height_px) {
+        Point2f rotated[4] = { src[3], src[0], src[1], src[2] };
+        copy(rotated, rotated + 4, src);
+        swap(width_px, height_px);
+    }
+    cal.source_pixels_per_cm = (width_px / A3_SHORT_CM + height_px / A3_LONG_CM) / 2.0;
+
+    const int w = cvRound(A3_SHORT_CM * canonical_px_per_cm);
+    const int h = cvRound(A3_LONG_CM * canonical_px_per_cm);
+    cal.canonical_size = Size(w, h);
+
+    Point2f dst[4] = { Point2f(0, 0), Point2f((float)w, 0), Point2f((float)w, (float)h), Point2f(0, (float)h) };
+    cal.homography = getPerspectiveTransform(src, dst);
+
+    // Карты обратного отображения: для каждого пикселя листа - точка на снимке
+    Mat inv = cal.homography.inv();
+    const double* m = inv.ptr<double>();
+    Mat map_x(h, w, CV_32FC1), map_y(h, w, CV_32FC1);
+    for (int y = 0; y < h; ++y) {
+        float* mx = map_x.ptr<float>(y);
+        float* my = map_y.ptr<float>(y);
+        for (int x = 0; x < w; ++x) {
+            double z = m[6] * x + m[7] * y + m[8];
+            double iz = z != 0 ? 1.0 / z : 0.0;
+            mx[x] = (float)((m[0] * x + m[1] * y + m[2]) * iz);
+            my[x] = (float)((m[3] * x + m[4] * y + m[5]) * iz);
+        }
+    }
+    convertMaps(map_x, map_y, cal.map1, cal.map2, CV_16SC2);
+
+    TL_LOG_DEBUG("Sheet calibration: " << (cal.sheet_found ? "corners found" : "full frame")
+        << ", source " << cal.source_pixels_per_cm << " px/cm, canonical " << w << "x" << h);
+    return cal;
+}
+
+void SheetCalibration::rectify(const Mat& image, Mat& rectified) const {
+    TL_PROFILE_SCOPE("rectify");
+    remap(image, rectified, map1, map2, INTER_LINEAR, BORDER_CONSTANT, Scalar(255, 255, 255));
+}
+
+const int CalibrationCache::MAX_RETRY_INTERVAL;
+
+shared_ptr<const SheetCalibration> CalibrationCache::get(const string& lane, const Mat& image) {
+    {
+        lock_guard<mutex> guard(lock_);
+        auto it = lanes_.find(lane);
+        if (it != lanes_.end() && it->second.calibration->source_size == image.size()) {
+            Lane& state = it->second;
+            if (state.calibration->sheet_found) return state.calibration;
+            // Лист не был найден (рука в кадре, лист еще не повешен) - ищем снова с нарастающим интервалом
+            if (state.frames_to_retry > 0) {
+                state.frames_to_retry--;
+                return state.calibration;
+            }
+            // Пока идет поиск, другие кадры линии берут прежнее допущение
+            state.frames_to_retry = numeric_limits<int>::max();
+        }
+    }
+
+    // Калибровка вне блокировки: другие линии не ждут
+    shared_ptr<const SheetCalibration> cal =
+        make_shared<const SheetCalibration>(calibrateSheet(image, canonical_px_per_cm_));
+
+    lock_guard<mutex> guard(lock_);
+    Lane& state = lanes_[lane];
+    const bool same_size = state.calibration && state.calibration->source_size == image.size();
+    if (same_size && state.calibration->sheet_found) return state.calibration;
+
+    if (cal->sheet_found) {
+        state.retry_interval = 1;
+        state.frames_to_retry = 0;
+    } else {
+        if (same_size) state.retry_interval = min(state.retry_interval * 2, MAX_RETRY_INTERVAL);
+        else state.retry_interval = 1;
+        state.frames_to_retry = state.retry_interval - 1;
+    }
+    state.calibration = cal;
+    return cal;
+}
+
+shared_ptr<const SheetCalibration> CalibrationCache::rectify(const string& lane, const Mat& image, Mat& rectified) {
+    shared_ptr<const SheetCalibration> cal = get(lane, image);
+    cal->rectify(image, rectified);
+    return cal;
+}
+
+void CalibrationCache::invalidate(const string& lane) {
+    lock_guard<mutex> guard(lock_);
+    lanes_.erase(lane);
+}
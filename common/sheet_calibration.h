@@ -0,0 +1,64 @@
+#ifndef SHEET_CALIBRATION_H
+#define SHEET_CALIBRATION_H
+
+#include <opencv2/core.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Калибровка неподвижной камеры по углам листа A3.
+// Гомография переводит снимок в каноническое изображение листа с заданным масштабом;
+// карты remap строятся один раз, дальше каждый кадр - один проход remap.
+struct SheetCalibration {
+    bool sheet_found = false;               // углы найдены (иначе - допущение "лист на весь кадр")
+    cv::Point2f corners[4];                 // углы листа на снимке: TL, TR, BR, BL
+    cv::Size source_size;                   // размер снимков, для которых действует калибровка
+    cv::Size canonical_size;                // размер выпрямленного листа
+    double pixels_per_cm = 0.0;             // масштаб выпрямленного листа
+    double source_pixels_per_cm = 0.0;      // реальный масштаб снимка по сторонам листа
+    cv::Mat homography;                     // снимок -> выпрямленный лист
+
+    cv::Mat map1, map2;                     // карты remap в формате с фиксированной точкой
+
+    // Выпрямить снимок (потокобезопасно: калибровка не меняется)
+    void rectify(const cv::Mat& image, cv::Mat& rectified) const;
+};
+
+// Поиск светлого четырехугольника листа; false, если лист не выделяется на фоне
+bool detectSheetCorners(const cv::Mat& image, cv::Point2f corners[4]);
+
+// Калибровка по одному снимку; canonical_px_per_cm - масштаб выпрямленного листа
+SheetCalibration calibrateSheet(const cv::Mat& image, double canonical_px_per_cm);
+
+// Калибровки по камерам/линиям. Потокобезопасен; калибровка пересчитывается,
+// только если изменился размер кадра или вызван invalidate. Допущение "лист на весь кадр"
+// не закрепляется: углы ищутся снова через 1, 2, 4, ... кадров (не реже чем раз в MAX_RETRY_INTERVAL).
+class CalibrationCache {
+public:
+    explicit CalibrationCache(double canonical_px_per_cm = 20.0) : canonical_px_per_cm_(canonical_px_per_cm) {}
+
+    std::shared_ptr<const SheetCalibration> get(const std::string& lane, const cv::Mat& image);
+
+    // Выпрямить снимок калибровкой линии (при первом снимке линии - откалибровать)
+    std::shared_ptr<const SheetCalibration> rectify(const std::string& lane, const cv::Mat& image, cv::Mat& rectified);
+
+    void invalidate(const std::string& lane);
+
+    double canonicalPixelsPerCM() const { return canonical_px_per_cm_; }
+
+    static const int MAX_RETRY_INTERVAL = 32;
+
+private:
+    struct Lane {
+        std::shared_ptr<const SheetCalibration> calibration;
+        int frames_to_retry = 0;            // кадров до повторного поиска углов (лист не найден)
+        int retry_interval = 1;
+    };
+
+    double canonical_px_per_cm_;
+    std::mutex lock_;
+    std::map<std::string, Lane> lanes_;
+};
+
+#endif
@@ -1,24 +1,31 @@
 ﻿#include "shooting_metrics.h"
+#include <opencv2/imgproc.hpp>
+#include "roi_utils.h"
+#include "profiler.h"
 #include <numeric>
 #include <algorithm>
 
 using namespace cv;
 using namespace std;
 
-ShootingMetrics ShootingMetricsCalculator::calculateMetrics(const vector<Point2f>& holes, double pixels_per_cm) {
+ShootingMetrics ShootingMetricsCalculator::calculateMetrics(const vector<Point2f>& holes, double pixels_per_cm,
+    STPConstruction* steps) {
+    TL_PROFILE_SCOPE("calculate_metrics");
     ShootingMetrics metrics;
     if (holes.empty()) return metrics;
 
-    metrics.stp = calculateSTP(holes);
+    metrics.stp = calculateSTP(holes, steps);
 
-    // Вычисляем расстояния до СТП
-    vector<double> distances;
+    // Среднее и максимальное расстояние до СТП за один проход, без промежуточного массива
+    double sum = 0.0, max_distance = 0.0;
     for (const auto& hole : holes) {
-        distances.push_back(norm(hole - metrics.stp));
+        double d = norm(hole - metrics.stp);
+        sum += d;
+        max_distance = max(max_distance, d);
     }
 
-    metrics.precision = accumulate(distances.begin(), distances.end(), 0.0) / holes.size();
-    metrics.group_radius = *max_element(distances.begin(), distances.end());
+    metrics.precision = sum / holes.size();
+    metrics.group_radius = max_distance;
 
     // Округляем до 2 знаков после запятой
     metrics.precision_cm = round((metrics.precision / pixels_per_cm) * 100.0) / 100.0;
@@ -27,61 +34,254 @@ ShootingMetrics ShootingMetricsCalculator::calculateMetrics(const vector<Point2f
     return metrics;
 }
 
-Point2f ShootingMetricsCalculator::findTargetCenter(const Mat& image) {
-    Mat gray, binary;
-    cvtColor(image, gray, COLOR_BGR2GRAY);
-
-    // Простая бинаризация черного
-    threshold(gray, binary, 80, 255, THRESH_BINARY_INV);
-
-    // Морфология для объединения
-    Mat kernel = getStructuringElement(MORPH_ELLIPSE, Size(9, 9));
-    morphologyEx(binary, binary, MORPH_CLOSE, kernel);
+Point2f ShootingMetricsCalculator::expectedCenter(const Mat& image) const {
+    if (reuse_last_center_ && has_last_center_ &&
+        last_center_.x >= 0 && last_center_.y >= 0 && last_center_.x < image.cols && last_center_.y < image.rows) {
+        return last_center_;
+    }
 
     // Ожидаемый центр (примерно 15см от левого края, 28см от верха)
     double expected_x = image.cols / 2.0;
     double expected_y = image.rows * 0.666;  // 28/42 ≈ 0.666
+    return Point2f(expected_x, expected_y);
+}
 
-    vector<vector<Point>> contours;
-    findContours(binary, contours, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
+Point2f ShootingMetricsCalculator::findTargetCenter(const Mat& image) {
+    TL_PROFILE_SCOPE("find_target_center");
+    Point2f expected = expectedCenter(image);
+    Point2f best_center;
+
+    if (!searchAround(image, expected, 9, 1000, best_center, nullptr)) {
+        has_last_center_ = false;
+        return Point2f(image.cols / 2.0f, image.rows * 0.666f);
+    }
+
+    last_center_ = best_center;
+    has_last_center_ = true;
+    return best_center;
+}
+
+Point2f ShootingMetricsCalculator::findTargetCenter(const Mat& image, int pyramid_scale) {
+    if (pyramid_scale <= 1) return findTargetCenter(image);
+    TL_PROFILE_SCOPE("find_target_center");
+
+    const int s = pyramid_scale;
+    Point2f expected = expectedCenter(image);
 
-    if (contours.empty()) {
-        return Point2f(expected_x, expected_y);
+    // Грубый поиск на уменьшенной копии: ядро и площадь пересчитаны на уровень пирамиды
+    Mat& small = small_;
+    resize(image, small, Size(image.cols / s, image.rows / s), 0, 0, INTER_AREA);
+
+    Point2f coarse_center;
+    Rect coarse_box;
+    int coarse_kernel = max(3, (9 / s) | 1);
+    if (!searchAround(small, expected * (1.0f / s), coarse_kernel, 1000.0 / (s * s), coarse_center, &coarse_box)) {
+        has_last_center_ = false;
+        return Point2f(image.cols / 2.0f, image.rows * 0.666f);
+    }
+
+    // Уточнение в окне полного разрешения вокруг найденного объекта
+    int margin = 9 + 2 * s;
+    Rect window(coarse_box.x * s - margin, coarse_box.y * s - margin,
+        coarse_box.width * s + 2 * margin, coarse_box.height * s + 2 * margin);
+    window &= Rect(0, 0, image.cols, image.rows);
+
+    Point2f best_center;
+    if (!findLargestBlackBlob(image, window, 9, 1000, best_center, nullptr)) {
+        best_center = coarse_center * (float)s + Point2f((s - 1) * 0.5f, (s - 1) * 0.5f);
+    }
+
+    last_center_ = best_center;
+    has_last_center_ = true;
+    return best_center;
+}
+
+bool ShootingMetricsCalculator::searchAround(const Mat& image, const Point2f& expected, int kernel_size,
+    double min_area, Point2f& center, Rect* bbox) {
+    const Rect frame(0, 0, image.cols, image.rows);
+    const double frame_area = (double)frame.area();
+
+    // Окно вокруг ожидаемой точки расширяется вдвое, пока объект не окажется в нем целиком.
+    // Объект принимается, только если он остается самым крупным и после еще одного удвоения окна:
+    // рядом с окном мог лежать более крупный черный объект. На весь кадр - прежний поиск по кадру.
+    // Окна вместе не больше 2/3 кадра: окно берется, только если в этот предел укладывается и окно
+    // его проверки, иначе сразу весь кадр. Крупный объект, не поместившийся в первое окно, ищется
+    // по кадру сразу (около 1.1 кадра вместо прежних 2.5)
+    const double window_budget = frame_area * 2.0 / 3.0;
+    auto windowAt = [&](int half) {
+        return Rect(cvRound(expected.x) - half, cvRound(expected.y) - half, 2 * half, 2 * half) & frame;
+    };
+
+    int half = max(kernel_size * 4, (int)(max(image.cols, image.rows) * 0.15));
+    double scanned = 0.0;
+    bool has_candidate = false;
+    Point2f candidate_center;
+    while (true) {
+        Rect window = windowAt(half);
+        const double next_area = (double)windowAt(half * 2).area();
+        // Окно поиска должно уложиться в предел вместе с окном проверки; окно проверки уже учтено
+        const double needed = window.area() + (has_candidate ? 0.0 : next_area);
+        if (window != frame && scanned + needed > window_budget) window = frame;
+        const bool whole_frame = window == frame;
+        scanned += window.area();
+
+        Point2f found_center;
+        Rect found_box;
+        bool found = findLargestBlackBlob(image, window, kernel_size, min_area, found_center, &found_box) &&
+            (whole_frame || !touchesInnerBorder(found_box, window, image.size()));
+        if (found && (whole_frame || (has_candidate && norm(found_center - candidate_center) < 1.0))) {
+            center = found_center;
+            if (bbox) *bbox = found_box;
+            return true;
+        }
+
+        if (whole_frame) return false;
+        has_candidate = found;
+        candidate_center = found_center;
+        half *= 2;
     }
+}
+
+const Mat& ShootingMetricsCalculator::ellipseKernel(int kernel_size) {
+    for (const auto& k : kernels_) {
+        if (k.first == kernel_size) return k.second;
+    }
+    kernels_.push_back(make_pair(kernel_size, getStructuringElement(MORPH_ELLIPSE, Size(kernel_size, kernel_size))));
+    return kernels_.back().second;
+}
+
+bool ShootingMetricsCalculator::findLargestBlackBlob(const Mat& image, const Rect& window, int kernel_size,
+    double min_area, Point2f& center, Rect* bbox) {
+    Mat& gray = gray_;
+    Mat& binary = binary_;
+    cvtColor(image(window), gray, COLOR_BGR2GRAY);
+
+    // Простая бинаризация черного
+    threshold(gray, binary, 80, 255, THRESH_BINARY_INV);
+
+    // Морфология для объединения
+    morphologyEx(binary, binary, MORPH_CLOSE, ellipseKernel(kernel_size));
+
+    vector<vector<Point>>& contours = contours_;
+    findContours(binary, contours, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE, window.tl());
 
     // Просто ищем самый большой черный объект
     double max_area = 0;
-    Point2f best_center(expected_x, expected_y);
+    bool found = false;
 
     for (const auto& contour : contours) {
         double area = contourArea(contour);
-        if (area > max_area && area > 1000) {  // Минимальная площадь
+        if (area > max_area && area > min_area) {  // Минимальная площадь
             max_area = area;
             Moments m = moments(contour);
-            best_center = Point2f(m.m10 / m.m00, m.m01 / m.m00);
+            center = Point2f(m.m10 / m.m00, m.m01 / m.m00);
+            if (bbox) *bbox = boundingRect(contour);
+            found = true;
         }
     }
 
-    return best_center;
+    return found;
 }
 
-Point2f ShootingMetricsCalculator::calculateSTP(const vector<Point2f>& holes) {
-    if (holes.size() != 4) {
-        // Простой центр масс для не-4 выстрелов
-        Point2f sum(0, 0);
-        for (const auto& hole : holes) sum += hole;
-        return sum * (1.0f / holes.size());
+void ShootingMetricsCalculator::findBlackBlobs(const Mat& image, int kernel_size, double min_area,
+    vector<Point2f>& centers, vector<Rect>& boxes, vector<double>& areas) {
+    centers.clear();
+    boxes.clear();
+    areas.clear();
+
+    Mat& gray = gray_;
+    Mat& binary = binary_;
+    cvtColor(image, gray, COLOR_BGR2GRAY);
+    threshold(gray, binary, 80, 255, THRESH_BINARY_INV);
+
+    morphologyEx(binary, binary, MORPH_CLOSE, ellipseKernel(kernel_size));
+
+    vector<vector<Point>>& contours = contours_;
+    findContours(binary, contours, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
+
+    for (const auto& contour : contours) {
+        double area = contourArea(contour);
+        if (area <= min_area) continue;
+        Moments m = moments(contour);
+        centers.push_back(Point2f(m.m10 / m.m00, m.m01 / m.m00));
+        boxes.push_back(boundingRect(contour));
+        areas.push_back(area);
     }
-    return calculateSTP4Shots(holes);
 }
 
-Point2f ShootingMetricsCalculator::calculateSTP4Shots(const vector<Point2f>& holes) {
+vector<Point2f> ShootingMetricsCalculator::findTargetCenters(const Mat& image, int pyramid_scale) {
+    TL_PROFILE_SCOPE("find_target_centers");
+    const int s = max(pyramid_scale, 1);
+
+    // Один проход по всему кадру (при s > 1 - по уменьшенной копии)
+    Mat small = image;
+    if (s > 1) {
+        resize(image, small_, Size(image.cols / s, image.rows / s), 0, 0, INTER_AREA);
+        small = small_;
+    }
+
+    vector<Point2f> centers;
+    vector<Rect> boxes;
+    vector<double> areas;
+    findBlackBlobs(small, max(3, (9 / s) | 1), 1000.0 / (s * s), centers, boxes, areas);
+    if (centers.empty()) return centers;
+
+    // Надписи и номера мельче мишеней
+    const double largest = *max_element(areas.begin(), areas.end());
+    vector<int> kept;
+    for (size_t i = 0; i < areas.size(); ++i) {
+        if (areas[i] >= 0.25 * largest) kept.push_back((int)i);
+    }
+
+    // Уточнение в окнах полного разрешения
+    if (s > 1) {
+        const Rect frame(0, 0, image.cols, image.rows);
+        const int margin = 9 + 2 * s;
+        for (int i : kept) {
+            const Rect& b = boxes[i];
+            Rect window(b.x * s - margin, b.y * s - margin, b.width * s + 2 * margin, b.height * s + 2 * margin);
+            window &= frame;
+            Point2f refined;
+            if (findLargestBlackBlob(image, window, 9, 1000, refined, nullptr)) centers[i] = refined;
+            else centers[i] = centers[i] * (float)s + Point2f((s - 1) * 0.5f, (s - 1) * 0.5f);
+            boxes[i] = Rect(b.x * s, b.y * s, b.width * s, b.height * s);
+        }
+    }
+
+    // Порядок чтения: строка начинается, когда центр ниже предыдущего больше чем на половину высоты мишени
+    sort(kept.begin(), kept.end(), [&centers](int a, int b) { return centers[a].y < centers[b].y; });
+    vector<int> row(kept.size(), 0);
+    for (size_t k = 1; k < kept.size(); ++k) {
+        const bool new_row = centers[kept[k]].y - centers[kept[k - 1]].y > 0.5 * boxes[kept[k - 1]].height;
+        row[k] = row[k - 1] + (new_row ? 1 : 0);
+    }
+    vector<int> order(kept.size());
+    for (size_t k = 0; k < kept.size(); ++k) order[k] = (int)k;
+    sort(order.begin(), order.end(), [&](int a, int b) {
+        if (row[a] != row[b]) return row[a] < row[b];
+        return centers[kept[a]].x < centers[kept[b]].x;
+        });
+
+    vector<Point2f> result;
+    for (int k : order) result.push_back(centers[kept[k]]);
+    return result;
+}
+
+Point2f ShootingMetricsCalculator::calculateSTP(const vector<Point2f>& holes, STPConstruction* steps) {
+    if (steps) steps->clear();
+    if (holes.size() < 2) return holes.empty() ? Point2f(0, 0) : holes[0];
+    return calculateSTPSequential(holes, steps);
+}
+
+Point2f ShootingMetricsCalculator::calculateSTPSequential(const vector<Point2f>& holes, STPConstruction* steps) {
+    const int n = (int)holes.size();
+
     // Находим ближайшую пару
     double min_dist = numeric_limits<double>::max();
     pair<int, int> closest_pair = { 0, 1 };
 
-    for (int i = 0; i < 4; i++) {
-        for (int j = i + 1; j < 4; j++) {
+    for (int i = 0; i < n; i++) {
+        for (int j = i + 1; j < n; j++) {
             double dist = norm(holes[i] - holes[j]);
             if (dist < min_dist) {
                 min_dist = dist;
@@ -90,34 +290,39 @@ Point2f ShootingMetricsCalculator::calculateSTP4Shots(const vector<Point2f>& hol
         }
     }
 
-    Point2f A = holes[closest_pair.first];
-    Point2f B = holes[closest_pair.second];
-    Point2f M1 = (A + B) * 0.5f;
+    stp_used_.assign(n, 0);
+    stp_used_[closest_pair.first] = stp_used_[closest_pair.second] = 1;
+    Point2f stp = (holes[closest_pair.first] + holes[closest_pair.second]) * 0.5f;
 
-    // Находим третью точку (ближайшую к M1)
-    Point2f C;
-    double min_dist_to_M1 = numeric_limits<double>::max();
+    if (steps) {
+        steps->points.push_back(holes[closest_pair.first]);
+        steps->points.push_back(holes[closest_pair.second]);
+        steps->means.push_back(stp);
+    }
 
-    for (int i = 0; i < 4; i++) {
-        if (i != closest_pair.first && i != closest_pair.second) {
-            double dist = norm(holes[i] - M1);
-            if (dist < min_dist_to_M1) {
-                min_dist_to_M1 = dist;
-                C = holes[i];
+    // Присоединяем оставшиеся точки по одной, начиная с ближайшей к текущей СТП
+    for (int k = 2; k < n; k++) {
+        int next = -1;
+        double min_dist_to_stp = numeric_limits<double>::max();
+        for (int i = 0; i < n; i++) {
+            if (stp_used_[i]) continue;
+            double dist = norm(holes[i] - stp);
+            if (dist < min_dist_to_stp) {
+                min_dist_to_stp = dist;
+                next = i;
             }
         }
-    }
 
-    Point2f M2 = M1 + (C - M1) * (1.0f / 3.0f);
+        stp_used_[next] = 1;
+        stp = stp + (holes[next] - stp) * (1.0f / (k + 1));
 
-    // Находим четвертую точку
-    Point2f D;
-    for (int i = 0; i < 4; i++) {
-        if (i != closest_pair.first && i != closest_pair.second && holes[i] != C) {
-            D = holes[i];
-            break;
+        // Сохраняем шаги для визуализации
+        if (steps) {
+            steps->points.push_back(holes[next]);
+            steps->means.push_back(stp);
         }
     }
 
-    return M2 + (D - M2) * (1.0f / 4.0f);
+    if (steps) steps->valid = true;
+    return stp;
 }
\ No newline at end of file
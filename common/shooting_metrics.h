@@ -1,7 +1,8 @@
 #ifndef SHOOTING_METRICS_H
 #define SHOOTING_METRICS_H
 
-#include <opencv2/opencv.hpp>
+#include <opencv2/core.hpp>
+#include <utility>
 #include <vector>
 
 struct ShootingMetrics {
@@ -14,14 +15,60 @@ struct ShootingMetrics {
     cv::Point2f target_center;      //   
 };
 
+//    :    ,    
+//     ,        1:k
+// (k -    ).    ,    
+struct STPConstruction {
+    bool valid = false;
+    std::vector<cv::Point2f> points;    //    ,   -  
+    std::vector<cv::Point2f> means;     // means[k] -   k + 2 ,  - 
+
+    void clear() {
+        valid = false;
+        points.clear();
+        means.clear();
+    }
+};
+
 class ShootingMetricsCalculator {
 public:
-    ShootingMetrics calculateMetrics(const std::vector<cv::Point2f>& holes, double pixels_per_cm);
-    cv::Point2f calculateSTP(const std::vector<cv::Point2f>& holes);
+    ShootingMetrics calculateMetrics(const std::vector<cv::Point2f>& holes, double pixels_per_cm,
+        STPConstruction* steps = nullptr);
+    cv::Point2f calculateSTP(const std::vector<cv::Point2f>& holes, STPConstruction* steps = nullptr);
     cv::Point2f findTargetCenter(const cv::Mat& image);  //  
+    cv::Point2f findTargetCenter(const cv::Mat& image, int pyramid_scale);  // - 
+
+    //    ,    (   ,    ).
+    //        
+    std::vector<cv::Point2f> findTargetCenters(const cv::Mat& image, int pyramid_scale = 1);
+
+    //       .      
+    //   ( , TargetAnalyzer ):      
+    void setReuseLastCenter(bool reuse) {
+        reuse_last_center_ = reuse;
+        has_last_center_ = false;
+    }
 
 private:
-    cv::Point2f calculateSTP4Shots(const std::vector<cv::Point2f>& holes);
+    cv::Point2f calculateSTPSequential(const std::vector<cv::Point2f>& holes, STPConstruction* steps);
+    bool findLargestBlackBlob(const cv::Mat& image, const cv::Rect& window, int kernel_size,
+        double min_area, cv::Point2f& center, cv::Rect* bbox);
+    void findBlackBlobs(const cv::Mat& image, int kernel_size, double min_area,
+        std::vector<cv::Point2f>& centers, std::vector<cv::Rect>& boxes, std::vector<double>& areas);
+    bool searchAround(const cv::Mat& image, const cv::Point2f& expected, int kernel_size,
+        double min_area, cv::Point2f& center, cv::Rect* bbox);
+    cv::Point2f expectedCenter(const cv::Mat& image) const;
+    const cv::Mat& ellipseKernel(int kernel_size);
+
+    bool reuse_last_center_ = false;
+    bool has_last_center_ = false;
+    cv::Point2f last_center_;
+
+    //   :     (   ),  
+    cv::Mat small_, gray_, binary_;
+    std::vector<std::vector<cv::Point>> contours_;
+    std::vector<std::pair<int, cv::Mat>> kernels_;
+    std::vector<uchar> stp_used_;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,507 @@
+#include "shot_history.h"
+#include "image_ingest.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+const uint32_t HISTORY_VERSION = 1;
+const size_t META_SIZE = 24;
+
+enum ColumnId {
+    COL_TIME,
+    COL_SHOOTER,
+    COL_WEAPON,
+    COL_HOLES_END,
+    COL_PRECISION,
+    COL_GROUP_RADIUS,
+    COL_DISTANCE,
+    COL_STP_DX,
+    COL_STP_DY,
+    COL_COUNT
+};
+
+struct ColumnFile {
+    const char* name;
+    size_t element_size;
+};
+
+// Порядок совпадает с ColumnId; колонки float - в порядке HistoryColumn, начиная с COL_PRECISION
+const ColumnFile COLUMN_FILES[COL_COUNT] = {
+    { "time.i64", 8 },
+    { "shooter.u32", 4 },
+    { "weapon.u32", 4 },
+    { "holes_end.u64", 8 },
+    { "precision_cm.f32", 4 },
+    { "group_radius_cm.f32", 4 },
+    { "distance_cm.f32", 4 },
+    { "stp_dx_cm.f32", 4 },
+    { "stp_dy_cm.f32", 4 }
+};
+
+const char* HOLES_FILE = "holes.f32x2";
+const char* META_FILE = "meta.bin";
+const char* SHOOTERS_FILE = "shooters.txt";
+const char* WEAPONS_FILE = "weapons.txt";
+
+bool isDirectory(const string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    return (st.st_mode & S_IFDIR) != 0;
+}
+
+bool makeDirectory(const string& path) {
+    if (isDirectory(path)) return true;
+#ifdef _WIN32
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+    return isDirectory(path);
+}
+
+string withSlash(const string& directory) {
+    if (directory.empty()) return "./";
+    if (directory.back() == '/' || directory.back() == '\\') return directory;
+    return directory + '/';
+}
+
+// Числа пишутся в порядке байт машины, как и в двоичном формате результатов
+template <typename T>
+void put(ostream& out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T get(const unsigned char* p) {
+    T value;
+    memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+// false - meta.bin есть, но не наш; отсутствие файла - пустая история
+bool readMeta(const string& path, bool& exists, uint64_t& count, bool& time_sorted) {
+    ifstream in(path, ios::binary);
+    exists = (bool)in;
+    count = 0;
+    time_sorted = true;
+    if (!exists) return true;
+
+    unsigned char meta[META_SIZE];
+    if (!in.read(reinterpret_cast<char*>(meta), META_SIZE)) return false;
+    if (memcmp(meta, "TLSH", 4) != 0 || get<uint32_t>(meta + 4) != HISTORY_VERSION) return false;
+    count = get<uint64_t>(meta + 8);
+    time_sorted = get<uint32_t>(meta + 16) != 0;
+    return true;
+}
+
+vector<string> readNames(const string& path) {
+    vector<string> names;
+    ifstream in(path);
+    string line;
+    while (getline(in, line)) names.push_back(line);
+    return names;
+}
+
+// Колонка для дозаписи с позиции records * element_size; хвост за ней - недописанные записи
+bool openColumn(const string& path, uint64_t records, size_t element_size, fstream& column) {
+    { ofstream create(path, ios::binary | ios::app); }
+    column.open(path, ios::in | ios::out | ios::binary);
+    if (!column) return false;
+
+    column.seekg(0, ios::end);
+    const uint64_t needed = records * element_size;
+    if ((uint64_t)column.tellg() < needed) return false;
+    column.seekp((streamoff)needed);
+    return (bool)column;
+}
+
+template <typename T>
+T readAt(fstream& column, uint64_t index) {
+    T value = T();
+    column.seekg((streamoff)(index * sizeof(T)));
+    column.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return value;
+}
+
+int64_t floorDiv(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+// Ближайший ранг; values переставляются
+double nearestRank(vector<float>& values, double p) {
+    if (values.empty()) return 0.0;
+    const size_t n = values.size();
+    size_t k = (size_t)max(0.0, ceil(min(max(p, 0.0), 1.0) * n) - 1.0);
+    k = min(k, n - 1);
+    nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+
+int findName(const vector<string>& names, const string& name) {
+    auto it = find(names.begin(), names.end(), name);
+    return it == names.end() ? -1 : (int)(it - names.begin());
+}
+
+} // namespace
+
+HistoryRecord makeHistoryRecord(int64_t timestamp, const string& shooter, const string& weapon,
+    const ShootingMetrics& metrics, const vector<Point2f>& holes, double pixels_per_cm) {
+    HistoryRecord record;
+    record.timestamp = timestamp;
+    record.shooter = shooter;
+    record.weapon = weapon;
+    record.precision_cm = metrics.precision_cm;
+    record.group_radius_cm = metrics.group_radius_cm;
+    record.distance_to_center_cm = metrics.distance_to_center_cm;
+
+    const float scale = pixels_per_cm > 0 ? (float)(1.0 / pixels_per_cm) : 0.0f;
+    record.stp_offset_cm = (metrics.stp - metrics.target_center) * scale;
+    record.holes_cm.reserve(holes.size());
+    for (const auto& h : holes) record.holes_cm.push_back((h - metrics.target_center) * scale);
+    return record;
+}
+
+bool ShotHistoryWriter::open(const string& directory) {
+    close();
+    directory_ = withSlash(directory);
+    if (!makeDirectory(directory_)) return false;
+
+    bool exists;
+    if (!readMeta(directory_ + META_FILE, exists, count_, time_sorted_)) return false;
+
+    shooters_ = readNames(directory_ + SHOOTERS_FILE);
+    weapons_ = readNames(directory_ + WEAPONS_FILE);
+    shooter_ids_.clear();
+    weapon_ids_.clear();
+    for (size_t i = 0; i < shooters_.size(); ++i) shooter_ids_.emplace(shooters_[i], (uint32_t)i);
+    for (size_t i = 0; i < weapons_.size(); ++i) weapon_ids_.emplace(weapons_[i], (uint32_t)i);
+    shooter_names_.open(directory_ + SHOOTERS_FILE, ios::out | ios::app);
+    weapon_names_.open(directory_ + WEAPONS_FILE, ios::out | ios::app);
+    if (!shooter_names_ || !weapon_names_) return false;
+
+    columns_.clear();
+    columns_.resize(COL_COUNT);
+    for (int c = 0; c < COL_COUNT; ++c) {
+        if (!openColumn(directory_ + COLUMN_FILES[c].name, count_, COLUMN_FILES[c].element_size, columns_[c])) {
+            columns_.clear();
+            return false;
+        }
+    }
+
+    holes_end_ = count_ > 0 ? readAt<uint64_t>(columns_[COL_HOLES_END], count_ - 1) : 0;
+    last_time_ = count_ > 0 ? readAt<int64_t>(columns_[COL_TIME], count_ - 1) : INT64_MIN;
+    if (!openColumn(directory_ + HOLES_FILE, holes_end_, 2 * sizeof(float), holes_)) {
+        columns_.clear();
+        return false;
+    }
+
+    open_ = true;
+    if (!exists) writeMeta();
+    return true;
+}
+
+uint32_t ShotHistoryWriter::nameId(vector<string>& names, unordered_map<string, uint32_t>& ids,
+    ofstream& file, const string& name) {
+    // Одно имя - одна строка словаря
+    string clean = name;
+    replace(clean.begin(), clean.end(), '\n', ' ');
+    replace(clean.begin(), clean.end(), '\r', ' ');
+
+    auto it = ids.find(clean);
+    if (it != ids.end()) return it->second;
+
+    const uint32_t id = (uint32_t)names.size();
+    names.push_back(clean);
+    ids.emplace(clean, id);
+    file << clean << '\n';
+    return id;
+}
+
+void ShotHistoryWriter::append(const HistoryRecord& record) {
+    lock_guard<mutex> guard(lock_);
+    if (!open_) return;
+
+    const uint32_t shooter = nameId(shooters_, shooter_ids_, shooter_names_, record.shooter);
+    const uint32_t weapon = nameId(weapons_, weapon_ids_, weapon_names_, record.weapon);
+
+    for (const auto& h : record.holes_cm) {
+        put<float>(holes_, h.x);
+        put<float>(holes_, h.y);
+    }
+    holes_end_ += record.holes_cm.size();
+
+    put<int64_t>(columns_[COL_TIME], record.timestamp);
+    put<uint32_t>(columns_[COL_SHOOTER], shooter);
+    put<uint32_t>(columns_[COL_WEAPON], weapon);
+    put<uint64_t>(columns_[COL_HOLES_END], holes_end_);
+    put<float>(columns_[COL_PRECISION], (float)record.precision_cm);
+    put<float>(columns_[COL_GROUP_RADIUS], (float)record.group_radius_cm);
+    put<float>(columns_[COL_DISTANCE], (float)record.distance_to_center_cm);
+    put<float>(columns_[COL_STP_DX], record.stp_offset_cm.x);
+    put<float>(columns_[COL_STP_DY], record.stp_offset_cm.y);
+
+    if (record.timestamp < last_time_) time_sorted_ = false;
+    last_time_ = record.timestamp;
+    count_++;
+}
+
+void ShotHistoryWriter::flush() {
+    lock_guard<mutex> guard(lock_);
+    if (!open_) return;
+
+    // Сначала данные и словари, затем счетчик записей
+    shooter_names_.flush();
+    weapon_names_.flush();
+    holes_.flush();
+    for (auto& column : columns_) column.flush();
+    writeMeta();
+}
+
+void ShotHistoryWriter::writeMeta() {
+    // Перезапись на месте: 24 байта не рвутся между секторами
+    const string path = directory_ + META_FILE;
+    fstream meta(path, ios::in | ios::out | ios::binary);
+    if (!meta) meta.open(path, ios::out | ios::binary);
+
+    meta.write("TLSH", 4);
+    put<uint32_t>(meta, HISTORY_VERSION);
+    put<uint64_t>(meta, count_);
+    put<uint32_t>(meta, time_sorted_ ? 1 : 0);
+    put<uint32_t>(meta, 0);
+}
+
+void ShotHistoryWriter::close() {
+    if (open_) flush();
+
+    // Файлы закрываются и после неудачного open()
+    lock_guard<mutex> guard(lock_);
+    columns_.clear();
+    holes_.close();
+    shooter_names_.close();
+    weapon_names_.close();
+    open_ = false;
+}
+
+ShotHistoryReader::ShotHistoryReader() {}
+
+ShotHistoryReader::~ShotHistoryReader() {}
+
+bool ShotHistoryReader::open(const string& directory) {
+    close();
+    const string dir = withSlash(directory);
+
+    bool exists;
+    if (!readMeta(dir + META_FILE, exists, count_, time_sorted_) || !exists) {
+        count_ = 0;
+        return false;
+    }
+    shooters_ = readNames(dir + SHOOTERS_FILE);
+    weapons_ = readNames(dir + WEAPONS_FILE);
+
+    // Пустые колонки не отображаются
+    columns_.resize(COL_COUNT);
+    for (int c = 0; c < COL_COUNT; ++c) {
+        columns_[c].reset(new MappedFile());
+        if (count_ == 0) continue;
+        if (!columns_[c]->open(dir + COLUMN_FILES[c].name) ||
+            columns_[c]->size() < count_ * COLUMN_FILES[c].element_size) {
+            close();
+            return false;
+        }
+    }
+
+    holes_.reset(new MappedFile());
+    const uint64_t holes_end = count_ > 0 ? get<uint64_t>(columns_[COL_HOLES_END]->data() + (count_ - 1) * 8) : 0;
+    if (holes_end > 0 && (!holes_->open(dir + HOLES_FILE) || holes_->size() < holes_end * 2 * sizeof(float))) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ShotHistoryReader::close() {
+    columns_.clear();
+    holes_.reset();
+    shooters_.clear();
+    weapons_.clear();
+    count_ = 0;
+    time_sorted_ = true;
+}
+
+const int64_t* ShotHistoryReader::timestamps() const {
+    return count_ > 0 ? reinterpret_cast<const int64_t*>(columns_[COL_TIME]->data()) : nullptr;
+}
+
+const float* ShotHistoryReader::column(HistoryColumn column) const {
+    const int c = COL_PRECISION + (int)column;
+    return count_ > 0 ? reinterpret_cast<const float*>(columns_[c]->data()) : nullptr;
+}
+
+template <typename F>
+void ShotHistoryReader::forEachRow(const HistoryQuery& query, F f) const {
+    if (count_ == 0) return;
+
+    // Имена сравниваются один раз, дальше - номера
+    const int shooter = query.shooter.empty() ? -1 : findName(shooters_, query.shooter);
+    const int weapon = query.weapon.empty() ? -1 : findName(weapons_, query.weapon);
+    if ((!query.shooter.empty() && shooter < 0) || (!query.weapon.empty() && weapon < 0)) return;
+
+    const int64_t* time = timestamps();
+    const uint32_t* shooters = reinterpret_cast<const uint32_t*>(columns_[COL_SHOOTER]->data());
+    const uint32_t* weapons = reinterpret_cast<const uint32_t*>(columns_[COL_WEAPON]->data());
+
+    size_t begin = 0, end = (size_t)count_;
+    bool check_time = query.from != INT64_MIN || query.to != INT64_MAX;
+    if (time_sorted_ && check_time) {
+        begin = lower_bound(time, time + end, query.from) - time;
+        end = lower_bound(time + begin, time + end, query.to) - time;
+        check_time = false;
+    }
+
+    for (size_t i = begin; i < end; ++i) {
+        if (shooter >= 0 && shooters[i] != (uint32_t)shooter) continue;
+        if (weapon >= 0 && weapons[i] != (uint32_t)weapon) continue;
+        if (check_time && (time[i] < query.from || time[i] >= query.to)) continue;
+        f((uint32_t)i);
+    }
+}
+
+vector<uint32_t> ShotHistoryReader::select(const HistoryQuery& query) const {
+    vector<uint32_t> rows;
+    forEachRow(query, [&](uint32_t row) { rows.push_back(row); });
+    return rows;
+}
+
+HistorySummary ShotHistoryReader::summarize(const HistoryQuery& query) const {
+    HistorySummary summary;
+    if (count_ == 0) return summary;
+
+    const float* precision = column(HistoryColumn::PrecisionCm);
+    const float* radius = column(HistoryColumn::GroupRadiusCm);
+    const float* distance = column(HistoryColumn::DistanceToCenterCm);
+    const float* dx = column(HistoryColumn::StpOffsetX);
+    const float* dy = column(HistoryColumn::StpOffsetY);
+
+    double sum_precision = 0, sum_radius = 0, sum_distance = 0, sum_dx = 0, sum_dy = 0;
+    vector<float> radii;
+    forEachRow(query, [&](uint32_t i) {
+        sum_precision += precision[i];
+        sum_radius += radius[i];
+        sum_distance += distance[i];
+        sum_dx += dx[i];
+        sum_dy += dy[i];
+        radii.push_back(radius[i]);
+        });
+
+    summary.count = radii.size();
+    if (summary.count == 0) return summary;
+
+    const double n = (double)summary.count;
+    summary.mean_precision_cm = sum_precision / n;
+    summary.mean_group_radius_cm = sum_radius / n;
+    summary.mean_distance_cm = sum_distance / n;
+    summary.mean_stp_offset_cm = Point2d(sum_dx / n, sum_dy / n);
+    summary.group_radius_p50_cm = nearestRank(radii, 0.5);
+    summary.group_radius_p90_cm = nearestRank(radii, 0.9);
+    return summary;
+}
+
+double ShotHistoryReader::percentile(const vector<uint32_t>& rows, HistoryColumn column, double p) const {
+    const float* values = this->column(column);
+    vector<float> selected;
+    selected.reserve(rows.size());
+    for (uint32_t row : rows) {
+        if (row < count_) selected.push_back(values[row]);
+    }
+    return nearestRank(selected, p);
+}
+
+vector<HistoryBucket> ShotHistoryReader::trend(const HistoryQuery& query, int64_t bucket_seconds) const {
+    vector<HistoryBucket> buckets;
+    if (count_ == 0 || bucket_seconds <= 0) return buckets;
+
+    const int64_t* time = timestamps();
+    const float* radius = column(HistoryColumn::GroupRadiusCm);
+    const float* distance = column(HistoryColumn::DistanceToCenterCm);
+    const float* dx = column(HistoryColumn::StpOffsetX);
+    const float* dy = column(HistoryColumn::StpOffsetY);
+
+    // Суммы по интервалам; в конце - деление на число записей
+    map<int64_t, HistoryBucket> sums;
+    forEachRow(query, [&](uint32_t i) {
+        const int64_t start = floorDiv(time[i], bucket_seconds) * bucket_seconds;
+        HistoryBucket& b = sums[start];
+        b.start = start;
+        b.count++;
+        b.mean_stp_offset_cm.x += dx[i];
+        b.mean_stp_offset_cm.y += dy[i];
+        b.mean_group_radius_cm += radius[i];
+        b.mean_distance_cm += distance[i];
+        });
+
+    buckets.reserve(sums.size());
+    for (auto& entry : sums) {
+        HistoryBucket b = entry.second;
+        const double n = (double)b.count;
+        b.mean_stp_offset_cm *= 1.0 / n;
+        b.mean_group_radius_cm /= n;
+        b.mean_distance_cm /= n;
+        buckets.push_back(b);
+    }
+    return buckets;
+}
+
+HistoryRecord ShotHistoryReader::record(uint32_t row) const {
+    HistoryRecord r;
+    if (row >= count_) return r;
+
+    const uint32_t shooter = reinterpret_cast<const uint32_t*>(columns_[COL_SHOOTER]->data())[row];
+    const uint32_t weapon = reinterpret_cast<const uint32_t*>(columns_[COL_WEAPON]->data())[row];
+    r.timestamp = timestamps()[row];
+    if (shooter < shooters_.size()) r.shooter = shooters_[shooter];
+    if (weapon < weapons_.size()) r.weapon = weapons_[weapon];
+    r.precision_cm = column(HistoryColumn::PrecisionCm)[row];
+    r.group_radius_cm = column(HistoryColumn::GroupRadiusCm)[row];
+    r.distance_to_center_cm = column(HistoryColumn::DistanceToCenterCm)[row];
+    r.stp_offset_cm = Point2f(column(HistoryColumn::StpOffsetX)[row], column(HistoryColumn::StpOffsetY)[row]);
+
+    const uint64_t* holes_end = reinterpret_cast<const uint64_t*>(columns_[COL_HOLES_END]->data());
+    const uint64_t begin = row > 0 ? holes_end[row - 1] : 0;
+    const float* holes = reinterpret_cast<const float*>(holes_->data());
+    for (uint64_t h = begin; h < holes_end[row]; ++h) {
+        r.holes_cm.push_back(Point2f(holes[2 * h], holes[2 * h + 1]));
+    }
+    return r;
+}
+
+void ShotHistoryReader::loadGroups(const vector<uint32_t>& rows, ShotGroups& groups) const {
+    groups.clear();
+    if (count_ == 0) return;
+
+    const uint64_t* holes_end = reinterpret_cast<const uint64_t*>(columns_[COL_HOLES_END]->data());
+    const float* holes = reinterpret_cast<const float*>(holes_->data());
+    for (uint32_t row : rows) {
+        // Несуществующая запись - пустая группа, чтобы номера групп совпадали с rows
+        if (row < count_) {
+            const uint64_t begin = row > 0 ? holes_end[row - 1] : 0;
+            for (uint64_t h = begin; h < holes_end[row]; ++h) {
+                groups.x.push_back(holes[2 * h]);
+                groups.y.push_back(holes[2 * h + 1]);
+            }
+        }
+        groups.ends.push_back(groups.x.size());
+    }
+}
@@ -0,0 +1,166 @@
+#ifndef SHOT_HISTORY_H
+#define SHOT_HISTORY_H
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <climits>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "shooting_metrics.h"
+#include "group_metrics.h"
+
+class MappedFile;
+
+// История стрельб: каталог с колонками фиксированной длины, только дозапись.
+//
+//   meta.bin              "TLSH", версия (u32), число записей (u64), флаг "время не убывает" (u32), резерв (u32)
+//   time.i64              время снимка, секунды Unix
+//   shooter.u32           номер стрелка в shooters.txt (строка файла)
+//   weapon.u32            номер профиля в weapons.txt
+//   holes_end.u64         конец пробоин записи в holes.f32x2 (начало - конец предыдущей)
+//   precision_cm.f32, group_radius_cm.f32, distance_cm.f32
+//   stp_dx_cm.f32, stp_dy_cm.f32   СТП относительно центра мишени
+//   holes.f32x2           пробоины относительно центра мишени, см
+//
+// Координаты хранятся в сантиметрах от центра мишени, поэтому сравнимы между снимками разного масштаба.
+// Число записей в meta.bin обновляется после сброса колонок: недописанный хвост после сбоя
+// не виден читателям и перезаписывается при следующем открытии.
+
+struct HistoryRecord {
+    int64_t timestamp = 0;
+    std::string shooter;
+    std::string weapon;
+    double precision_cm = 0.0;
+    double group_radius_cm = 0.0;
+    double distance_to_center_cm = 0.0;
+    cv::Point2f stp_offset_cm;                  // x - вправо, y - вниз
+    std::vector<cv::Point2f> holes_cm;
+};
+
+// Запись истории по метрикам снимка (пиксели переводятся в см от центра мишени)
+HistoryRecord makeHistoryRecord(int64_t timestamp, const std::string& shooter, const std::string& weapon,
+    const ShootingMetrics& metrics, const std::vector<cv::Point2f>& holes, double pixels_per_cm);
+
+// Дозапись в историю. append() потокобезопасен; записи становятся видны читателям после flush()
+class ShotHistoryWriter {
+public:
+    ShotHistoryWriter() {}
+    ~ShotHistoryWriter() { close(); }
+
+    // Каталог создается, если его нет; существующая история продолжается
+    bool open(const std::string& directory);
+    void append(const HistoryRecord& record);
+    void flush();
+    void close();
+
+    bool isOpen() const { return open_; }
+    uint64_t size() const { return count_; }
+
+    ShotHistoryWriter(const ShotHistoryWriter&) = delete;
+    ShotHistoryWriter& operator=(const ShotHistoryWriter&) = delete;
+
+private:
+    uint32_t nameId(std::vector<std::string>& names, std::unordered_map<std::string, uint32_t>& ids,
+        std::ofstream& file, const std::string& name);
+    void writeMeta();
+
+    std::string directory_;
+    bool open_ = false;
+    std::vector<std::fstream> columns_;
+    std::fstream holes_;
+    std::ofstream shooter_names_, weapon_names_;
+    std::vector<std::string> shooters_, weapons_;
+    std::unordered_map<std::string, uint32_t> shooter_ids_, weapon_ids_;
+    uint64_t count_ = 0;
+    uint64_t holes_end_ = 0;
+    int64_t last_time_ = INT64_MIN;
+    bool time_sorted_ = true;
+    std::mutex lock_;
+};
+
+// Отбор записей: пустое имя - любое, время - полуинтервал [from, to)
+struct HistoryQuery {
+    std::string shooter;
+    std::string weapon;
+    int64_t from = INT64_MIN;
+    int64_t to = INT64_MAX;
+};
+
+enum class HistoryColumn {
+    PrecisionCm,
+    GroupRadiusCm,
+    DistanceToCenterCm,
+    StpOffsetX,
+    StpOffsetY
+};
+
+struct HistorySummary {
+    size_t count = 0;
+    double mean_precision_cm = 0.0;
+    double mean_group_radius_cm = 0.0;
+    double mean_distance_cm = 0.0;
+    cv::Point2d mean_stp_offset_cm;
+    double group_radius_p50_cm = 0.0;
+    double group_radius_p90_cm = 0.0;
+};
+
+// Средние за интервал времени (смещение СТП, кучность, удаление от центра)
+struct HistoryBucket {
+    int64_t start = 0;
+    size_t count = 0;
+    cv::Point2d mean_stp_offset_cm;
+    double mean_group_radius_cm = 0.0;
+    double mean_distance_cm = 0.0;
+};
+
+// Чтение истории через отображение колонок в память. Видит записи на момент open();
+// запросы - проходы по колонкам без разбора текста, при неубывающем времени диапазон ищется бинарно.
+class ShotHistoryReader {
+public:
+    ShotHistoryReader();
+    ~ShotHistoryReader();
+
+    bool open(const std::string& directory);
+    void close();
+
+    size_t size() const { return (size_t)count_; }
+
+    // Номера записей по запросу, в порядке дозаписи
+    std::vector<uint32_t> select(const HistoryQuery& query) const;
+
+    // Средние и перцентили радиуса группы за один проход
+    HistorySummary summarize(const HistoryQuery& query) const;
+
+    // Перцентиль колонки по выбранным записям, p в [0, 1] (ближайший ранг)
+    double percentile(const std::vector<uint32_t>& rows, HistoryColumn column, double p) const;
+
+    // Средние по интервалам bucket_seconds от начала эпохи; пустые интервалы пропускаются
+    std::vector<HistoryBucket> trend(const HistoryQuery& query, int64_t bucket_seconds) const;
+
+    HistoryRecord record(uint32_t row) const;
+
+    // Пробоины выбранных записей (см от центра мишени) - группами для computeGroupMetrics
+    void loadGroups(const std::vector<uint32_t>& rows, ShotGroups& groups) const;
+
+    const int64_t* timestamps() const;
+    const float* column(HistoryColumn column) const;
+
+    ShotHistoryReader(const ShotHistoryReader&) = delete;
+    ShotHistoryReader& operator=(const ShotHistoryReader&) = delete;
+
+private:
+    template <typename F>
+    void forEachRow(const HistoryQuery& query, F f) const;
+
+    std::vector<std::unique_ptr<MappedFile>> columns_;
+    std::unique_ptr<MappedFile> holes_;
+    std::vector<std::string> shooters_, weapons_;
+    uint64_t count_ = 0;
+    bool time_sorted_ = true;
+};
+
+#endif
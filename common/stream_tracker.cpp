@@ -0,0 +1,182 @@
+#include "stream_tracker.h"
+#include <opencv2/imgproc.hpp>
+#include "roi_utils.h"
+#include <algorithm>
+#include <cstdlib>
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+// Плитка считается изменившейся, если в ней достаточно пикселей с заметной разницей по любому каналу
+class ChangedTilesBody : public ParallelLoopBody {
+public:
+    ChangedTilesBody(const Mat& frame, const Mat& reference, int tile_size, int tiles_x,
+        int pixel_threshold, int min_changed_pixels, vector<uchar>& dirty)
+        : frame_(frame), reference_(reference), tile_size_(tile_size), tiles_x_(tiles_x),
+          pixel_threshold_(pixel_threshold), min_changed_pixels_(min_changed_pixels), dirty_(dirty) {}
+
+    void operator()(const Range& range) const override {
+        for (int ty = range.start; ty < range.end; ++ty) {
+            int y0 = ty * tile_size_;
+            int y1 = min(y0 + tile_size_, frame_.rows);
+            for (int tx = 0; tx < tiles_x_; ++tx) {
+                int x0 = tx * tile_size_;
+                int x1 = min(x0 + tile_size_, frame_.cols);
+                int changed = 0;
+                for (int y = y0; y < y1 && changed < min_changed_pixels_; ++y) {
+                    const uchar* a = frame_.ptr<uchar>(y) + x0 * 3;
+                    const uchar* b = reference_.ptr<uchar>(y) + x0 * 3;
+                    for (int i = 0; i < (x1 - x0) * 3; i += 3) {
+                        int d = max(abs(a[i] - b[i]), max(abs(a[i + 1] - b[i + 1]), abs(a[i + 2] - b[i + 2])));
+                        if (d > pixel_threshold_) changed++;
+                    }
+                }
+                dirty_[ty * tiles_x_ + tx] = changed >= min_changed_pixels_;
+            }
+        }
+    }
+
+private:
+    const Mat& frame_;
+    const Mat& reference_;
+    int tile_size_, tiles_x_, pixel_threshold_, min_changed_pixels_;
+    vector<uchar>& dirty_;
+};
+
+bool insideRect(const Rect& inner, const Rect& outer) {
+    return (inner & outer) == inner;
+}
+
+}
+
+StreamHoleTracker::StreamHoleTracker(const DetectionLimits& limits, int tile_size, int pixel_threshold,
+    int min_changed_pixels)
+    : limits_(limits), tile_size_(tile_size), pixel_threshold_(pixel_threshold), min_changed_pixels_(min_changed_pixels) {}
+
+void StreamHoleTracker::reset() {
+    reference_.release();
+    red_mask_.release();
+    clusters_.clear();
+    holes_.clear();
+    dirty_.clear();
+}
+
+StreamFrameResult StreamHoleTracker::processFrame(const Mat& frame) {
+    CV_Assert(frame.type() == CV_8UC3);
+    StreamFrameResult result;
+
+    vector<Rect>& regions = regions_;
+    regions.clear();
+
+    if (reference_.empty() || reference_.size() != frame.size()) {
+        // Первый кадр: полный проход
+        reset();
+        frame.copyTo(reference_);
+        red_mask_.create(frame.rows, frame.cols, CV_8UC1);
+        pixels_per_cm_ = detector_.calculatePixelsPerCM(frame);
+
+        tiles_x_ = (frame.cols + tile_size_ - 1) / tile_size_;
+        tiles_y_ = (frame.rows + tile_size_ - 1) / tile_size_;
+        dirty_.assign(tiles_x_ * tiles_y_, 1);
+
+        result.full_scan = true;
+        result.changed_tiles = tiles_x_ * tiles_y_;
+        regions.push_back(Rect(0, 0, frame.cols, frame.rows));
+    } else {
+        result.changed_tiles = findChangedTiles(frame);
+        if (result.changed_tiles == 0) return result;
+        changedRegions(regions);
+
+        // Эталон обновляется только в изменившихся плитках
+        for (int ty = 0; ty < tiles_y_; ++ty) {
+            for (int tx = 0; tx < tiles_x_; ++tx) {
+                if (!dirty_[ty * tiles_x_ + tx]) continue;
+                Rect tile = Rect(tx * tile_size_, ty * tile_size_, tile_size_, tile_size_)
+                    & Rect(0, 0, frame.cols, frame.rows);
+                frame(tile).copyTo(reference_(tile));
+            }
+        }
+    }
+
+    for (const auto& region : regions) {
+        rescanRegion(frame, region);
+    }
+
+    // Объединение близких кластеров и поиск новых пробоин
+    vector<DetectedHole>& raw = raw_;
+    raw.clear();
+    for (const auto& c : clusters_) raw.push_back(c.hole);
+
+    // Прежний список пробоин - для сравнения, новый пишется на его место
+    double merge_px = limits_.merge_radius_cm * pixels_per_cm_;
+    previous_.swap(holes_);
+    detector_.mergeCloseHoles(raw, merge_px, holes_, merge_workspace_);
+
+    for (const auto& h : holes_) {
+        bool known = false;
+        for (const auto& p : previous_) {
+            if (norm(h.center - p.center) <= merge_px) {
+                known = true;
+                break;
+            }
+        }
+        if (!known) result.new_holes.push_back(h);
+    }
+
+    return result;
+}
+
+int StreamHoleTracker::findChangedTiles(const Mat& frame) {
+    parallel_for_(Range(0, tiles_y_), ChangedTilesBody(frame, reference_, tile_size_, tiles_x_,
+        pixel_threshold_, min_changed_pixels_, dirty_));
+    return (int)count(dirty_.begin(), dirty_.end(), 1);
+}
+
+void StreamHoleTracker::changedRegions(vector<Rect>& regions) const {
+    // Запас вокруг изменений, чтобы пробоина на границе плитки попала в область целиком
+    const int max_hole_px = (int)ceil(2.0 * sqrt(limits_.max_cluster_area / CV_PI));
+    const int margin = (max_hole_px + tile_size_ - 1) / tile_size_;
+    const Rect frame_rect(0, 0, reference_.cols, reference_.rows);
+
+    regions.clear();
+    for (int ty = 0; ty < tiles_y_; ++ty) {
+        for (int tx = 0; tx < tiles_x_; ++tx) {
+            if (!dirty_[ty * tiles_x_ + tx]) continue;
+            Rect r((tx - margin) * tile_size_, (ty - margin) * tile_size_,
+                (2 * margin + 1) * tile_size_, (2 * margin + 1) * tile_size_);
+            regions.push_back(r & frame_rect);
+        }
+    }
+
+    mergeOverlappingRects(regions);
+}
+
+void StreamHoleTracker::rescanRegion(const Mat& frame, const Rect& region) {
+    Mat mask = red_mask_(region);
+    limits_.red_classifier->classify(frame(region), mask);
+
+    // Кластеры, целиком лежащие в области, будут найдены заново
+    clusters_.erase(remove_if(clusters_.begin(), clusters_.end(), [&region](const TrackedCluster& c) {
+        return insideRect(c.bbox, region);
+        }), clusters_.end());
+
+    int num_components = connectedComponentStats(mask, stats_, centroids_, components_);
+    const Mat& stats = stats_;
+    const Mat& centroids = centroids_;
+
+    for (int i = 1; i < num_components; i++) {
+        int area = stats.at<int>(i, CC_STAT_AREA);
+        if (area < limits_.min_cluster_area || area > limits_.max_cluster_area) continue;
+
+        Rect bbox(stats.at<int>(i, CC_STAT_LEFT) + region.x, stats.at<int>(i, CC_STAT_TOP) + region.y,
+            stats.at<int>(i, CC_STAT_WIDTH), stats.at<int>(i, CC_STAT_HEIGHT));
+
+        // Обрезанную компоненту учитывает старый список
+        if (touchesInnerBorder(bbox, region, red_mask_.size())) continue;
+
+        Point2f center(centroids.at<double>(i, 0) + region.x, centroids.at<double>(i, 1) + region.y);
+        clusters_.push_back({ { center, area }, bbox });
+    }
+}
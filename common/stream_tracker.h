@@ -0,0 +1,65 @@
+#ifndef STREAM_TRACKER_H
+#define STREAM_TRACKER_H
+
+#include <opencv2/core.hpp>
+#include <vector>
+#include "hole_detector.h"
+
+// Результат обработки одного кадра потока
+struct StreamFrameResult {
+    std::vector<DetectedHole> new_holes;    // пробоины, появившиеся в этом кадре
+    int changed_tiles = 0;                  // сколько плиток пересчитано
+    bool full_scan = false;                 // первый кадр или смена размера
+};
+
+// Инкрементальная детекция пробоин для неподвижной камеры.
+// Хранит маску красного и кластеры предыдущих кадров; в новом кадре
+// классификация и связные компоненты считаются только в изменившихся плитках.
+// Пороги красного, площади кластеров и радиус объединения - профиля упражнения (Weapon::detectionLimits)
+class StreamHoleTracker {
+public:
+    explicit StreamHoleTracker(const DetectionLimits& limits = HoleDetector::limits(), int tile_size = 64,
+        int pixel_threshold = 40, int min_changed_pixels = 8);
+
+    StreamFrameResult processFrame(const cv::Mat& frame);
+    void reset();
+
+    // Все известные пробоины (после объединения близких)
+    const std::vector<DetectedHole>& holes() const { return holes_; }
+    const cv::Mat& redMask() const { return red_mask_; }
+    double pixelsPerCM() const { return pixels_per_cm_; }
+
+private:
+    struct TrackedCluster {
+        DetectedHole hole;
+        cv::Rect bbox;
+    };
+
+    DetectionLimits limits_;
+    int tile_size_;
+    int pixel_threshold_;
+    int min_changed_pixels_;
+
+    HoleDetectorBase detector_;
+    cv::Mat reference_;                     // последнее учтенное содержимое каждой плитки
+    cv::Mat red_mask_;
+    std::vector<TrackedCluster> clusters_;
+    std::vector<DetectedHole> holes_;
+    double pixels_per_cm_ = 0.0;
+
+    int tiles_x_ = 0, tiles_y_ = 0;
+    std::vector<uchar> dirty_;
+
+    // Буферы кадра: в установившемся режиме обработка кадра не выделяет память
+    std::vector<DetectedHole> previous_, raw_;
+    std::vector<cv::Rect> regions_;
+    ComponentsWorkspace components_;
+    cv::Mat stats_, centroids_;
+    MergeWorkspace merge_workspace_;
+
+    int findChangedTiles(const cv::Mat& frame);
+    void changedRegions(std::vector<cv::Rect>& regions) const;
+    void rescanRegion(const cv::Mat& frame, const cv::Rect& region);
+};
+
+#endif
@@ -0,0 +1,193 @@
+#include "target_analyzer.h"
+#include <opencv2/imgproc.hpp>
+#include "analysis_context.h"
+#include "image_ingest.h"
+#include "sheet_calibration.h"
+#include "visualization.h"
+#include "profiler.h"
+
+using namespace cv;
+using namespace std;
+
+TargetAnalyzer::TargetAnalyzer()
+    : weapon_(createWeapon(PMProfile::name())), preview_weapon_(createWeapon(PMProfile::name())) {}
+
+bool TargetAnalyzer::setWeapon(const string& name) {
+    unique_ptr<Weapon> weapon = createWeapon(name);
+    if (!weapon) return false;
+    weapon_ = move(weapon);
+    preview_weapon_ = createWeapon(name);
+    weapon_->setReuseLastCenter(calibration_ != nullptr);
+    preview_weapon_->setReuseLastCenter(calibration_ != nullptr);
+    return true;
+}
+
+void TargetAnalyzer::setCalibration(CalibrationCache* cache, const string& lane) {
+    calibration_ = cache;
+    lane_ = lane;
+    weapon_->setReuseLastCenter(calibration_ != nullptr);
+    preview_weapon_->setReuseLastCenter(calibration_ != nullptr);
+}
+
+TargetAnalysisResult TargetAnalyzer::analyzeEncoded(const unsigned char* data, size_t size) {
+    if (!data || size == 0) {
+        TargetAnalysisResult result;
+        result.error = "empty buffer";
+        return result;
+    }
+
+    // Буфер декодируется на месте, без копирования
+    IngestOptions options;
+    options.target_pixels_per_cm = target_pixels_per_cm_;
+    TargetAnalysisResult result;
+    if (!ingestBuffer(data, size, options, ingested_, &result.error)) {
+        return result;
+    }
+    return analyzeImage(ingested_.image, ingested_.reduction);
+}
+
+TargetAnalysisResult TargetAnalyzer::analyzeBGR(const unsigned char* pixels, int width, int height, size_t stride) {
+    if (!pixels || width <= 0 || height <= 0 || stride < (size_t)width * 3) {
+        TargetAnalysisResult result;
+        result.error = "invalid pixel buffer";
+        return result;
+    }
+
+    Mat image(height, width, CV_8UC3, (void*)pixels, stride);
+    return analyze(image);
+}
+
+TargetAnalysisResult TargetAnalyzer::analyze(const Mat& image) {
+    return analyzeImage(image, 1);
+}
+
+TargetAnalysisResult TargetAnalyzer::analyzeImage(const Mat& image, int reduction) {
+    TargetAnalysisResult result;
+    if (image.empty() || image.type() != CV_8UC3) {
+        result.error = "expected 8-bit BGR image";
+        return result;
+    }
+
+    // Координаты результата - в системе выпрямленного листа, если задана калибровка
+    Mat sheet = image;
+    if (calibration_) {
+        calibration_->rectify(lane_, image, rectified_);
+        sheet = rectified_;
+    }
+
+    // Контекст живет в анализаторе: буферы детектора переиспользуются между снимками
+    AnalysisContext& ctx = ctx_;
+    ctx.reset(sheet);
+    ctx.coarse_to_fine = coarse_to_fine_;
+    ctx.hook_zone_first = hook_zone_first_;
+    if (!calibration_) ctx.area_scale = 1.0 / ((double)reduction * reduction);
+    if (sheets_across_ > 1) ctx.preset_pixels_per_cm = HoleDetectorBase::sheetsPixelsPerCM(sheet.size(), sheets_across_);
+
+    if (multi_target_) {
+        weapon_->analyzeTargets(ctx);
+        result.pixels_per_cm = ctx.pixels_per_cm;
+        result.detections = ctx.merged;
+        result.targets = ctx.targets;
+        for (const auto& g : ctx.targets) {
+            if (!g.shots.empty()) result.ok = true;
+        }
+        if (!result.ok) result.error = "no holes detected";
+        return result;
+    }
+
+    weapon_->analyze(ctx);
+
+    result.pixels_per_cm = ctx.pixels_per_cm;
+    result.detections = ctx.detections;
+    if (ctx.shots.empty()) {
+        result.error = "no holes detected";
+        return result;
+    }
+
+    result.holes = ctx.shots;
+    result.metrics = ctx.metrics;
+    result.ok = true;
+    return result;
+}
+
+future<TargetAnalysisResult> TargetAnalyzer::analyzeEncodedWithPreview(const unsigned char* data, size_t size,
+    TargetPreview& preview) {
+    preview = TargetPreview();
+    if (!data || size == 0) {
+        preview.result.error = "empty buffer";
+        promise<TargetAnalysisResult> failed;
+        failed.set_value(preview.result);
+        return failed.get_future();
+    }
+
+    // Для превью JPEG декодируется сразу с уменьшением 1/2-1/8
+    IngestOptions options;
+    options.target_pixels_per_cm = preview_pixels_per_cm_;
+    if (ingestBuffer(data, size, options, preview_ingested_, &preview.result.error)) {
+        analyzePreview(preview_ingested_.image, preview_ingested_.reduction, preview);
+    }
+
+    return async(launch::async, [this, data, size] { return analyzeEncoded(data, size); });
+}
+
+future<TargetAnalysisResult> TargetAnalyzer::analyzeWithPreview(const Mat& image, TargetPreview& preview) {
+    preview = TargetPreview();
+    analyzePreview(image, 1, preview);
+    return async(launch::async, [this, image] { return analyze(image); });
+}
+
+void TargetAnalyzer::analyzePreview(const Mat& image, int reduction, TargetPreview& preview) {
+    TL_PROFILE_SCOPE("preview");
+    TargetAnalysisResult& result = preview.result;
+    if (image.empty() || image.type() != CV_8UC3) {
+        result.error = "expected 8-bit BGR image";
+        return;
+    }
+
+    // Уменьшенные снимки калибруются отдельно: размер кадра другой, и общая калибровка линии
+    // пересчитывалась бы на каждом снимке
+    Mat sheet = image;
+    double sheet_ppc;
+    if (calibration_) {
+        calibration_->rectify(lane_ + "#preview", image, preview_rectified_);
+        sheet = preview_rectified_;
+        sheet_ppc = calibration_->canonicalPixelsPerCM();
+    } else {
+        sheet_ppc = HoleDetectorBase::sheetsPixelsPerCM(sheet.size(), sheets_across_);
+    }
+
+    const double scale = preview_pixels_per_cm_ / sheet_ppc;
+    if (scale < 1.0) {
+        resize(sheet, preview_small_, Size(), scale, scale, INTER_AREA);
+        sheet = preview_small_;
+    }
+
+    // Тот же модуль оружия, что и для полного снимка: пороги в см пересчитываются по масштабу превью
+    AnalysisContext& ctx = preview_ctx_;
+    ctx.reset(sheet);
+    ctx.preset_pixels_per_cm = sheet_ppc * min(scale, 1.0);
+    // Пороги площади профиля - в пикселях полного анализа: выпрямленного листа с калибровкой,
+    // иначе снимка до уменьшения при декодировании
+    const double linear_scale = calibration_ ? min(scale, 1.0) : min(scale, 1.0) / reduction;
+    ctx.area_scale = linear_scale * linear_scale;
+    if (multi_target_) {
+        preview_weapon_->analyzeTargets(ctx);
+        result.targets = ctx.targets;
+        for (const auto& g : ctx.targets) {
+            if (!g.shots.empty()) result.ok = true;
+        }
+    } else {
+        preview_weapon_->analyze(ctx);
+        result.holes = ctx.shots;
+        result.metrics = ctx.metrics;
+        result.ok = !ctx.shots.empty();
+    }
+    result.pixels_per_cm = ctx.pixels_per_cm;
+    result.detections = multi_target_ ? ctx.merged : ctx.detections;
+    if (!result.ok) result.error = "no holes detected";
+
+    sheet.copyTo(preview.image);
+    Visualization visualizer(ctx.pixels_per_cm);
+    if (multi_target_) visualizer.drawTargetGroups(preview.image, ctx);
+    else if (result.ok) visualizer.drawShootingResult(preview.image, ctx);
+}
@@ -0,0 +1,104 @@
+#ifndef TARGET_ANALYZER_H
+#define TARGET_ANALYZER_H
+
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include "hole_detector.h"
+#include "shooting_metrics.h"
+#include "analysis_context.h"
+#include "image_ingest.h"
+#include "../weapons/weapon_registry.h"
+
+// Результат анализа снимка из памяти
+struct TargetAnalysisResult {
+    bool ok = false;
+    std::string error;
+    std::vector<DetectedHole> detections;   // все кандидаты детектора
+    std::vector<cv::Point2f> holes;         // выстрелы, по которым считаны метрики
+    ShootingMetrics metrics = ShootingMetrics();
+    double pixels_per_cm = 0.0;
+    std::vector<TargetGroup> targets;       // по мишени, если включен режим нескольких мишеней
+};
+
+// Предварительный результат по сильно уменьшенной копии снимка
+struct TargetPreview {
+    TargetAnalysisResult result;            // координаты - в пикселях превью, result.pixels_per_cm - его масштаб
+    cv::Mat image;                          // размеченное превью (тот же рисунок, что и полный результат)
+};
+
+// Встраиваемый анализатор: снимок передается из памяти, без файлов на диске и без GUI.
+// Экземпляр не потокобезопасен - по одному на поток.
+class CalibrationCache;
+
+class TargetAnalyzer {
+public:
+    TargetAnalyzer();
+
+    // Профиль упражнения ("pm", "ak", "rifle"); false для неизвестного имени
+    bool setWeapon(const std::string& name);
+
+    // Закодированный снимок (JPEG, PNG, ...) в памяти
+    TargetAnalysisResult analyzeEncoded(const unsigned char* data, size_t size);
+
+    // Сырые пиксели BGR, 8 бит на канал; stride - байт на строку
+    TargetAnalysisResult analyzeBGR(const unsigned char* pixels, int width, int height, size_t stride);
+
+    TargetAnalysisResult analyze(const cv::Mat& image);
+
+    // Двухфазный анализ: preview заполняется до возврата по копии с масштабом setPreviewPixelsPerCM
+    // (JPEG сразу декодируется уменьшенным), полный результат считается в фоне и приходит через future.
+    // Пока future не готов, анализатор занят, а буфер data или пиксели image должны оставаться живыми
+    std::future<TargetAnalysisResult> analyzeEncodedWithPreview(const unsigned char* data, size_t size,
+        TargetPreview& preview);
+    std::future<TargetAnalysisResult> analyzeWithPreview(const cv::Mat& image, TargetPreview& preview);
+
+    // Масштаб превью, px/см; по умолчанию 10 - лист A3 около 300x420
+    void setPreviewPixelsPerCM(double pixels_per_cm) { preview_pixels_per_cm_ = pixels_per_cm; }
+
+    void setCoarseToFine(bool enabled) { coarse_to_fine_ = enabled; }
+
+    // Сканировать зону крючков, только если ниже нее не хватило пробоин (результат тот же)
+    void setHookZoneFirst(bool enabled) { hook_zone_first_ = enabled; }
+
+    // Несколько мишеней на листе; sheets_across - сколько листов A3 рядом в кадре (для масштаба)
+    void setMultiTarget(bool enabled, int sheets_across = 1) { multi_target_ = enabled; sheets_across_ = sheets_across; }
+
+    // Выпрямлять снимки по калибровке линии; кэш может быть общим для нескольких анализаторов
+    // Анализатор линии - кадры одной неподвижной камеры: центр мишени ищется от центра предыдущего снимка
+    void setCalibration(CalibrationCache* cache, const std::string& lane);
+
+    // Для JPEG-буферов: декодировать с уменьшением до заданного масштаба (0 - полное разрешение)
+    void setTargetPixelsPerCM(double pixels_per_cm) { target_pixels_per_cm_ = pixels_per_cm; }
+
+private:
+    // reduction - во сколько раз снимок уменьшен при декодировании (пороги площади профиля)
+    TargetAnalysisResult analyzeImage(const cv::Mat& image, int reduction);
+    void analyzePreview(const cv::Mat& image, int reduction, TargetPreview& preview);
+
+    std::unique_ptr<Weapon> weapon_;
+    bool coarse_to_fine_ = false;
+    bool hook_zone_first_ = false;
+    double target_pixels_per_cm_ = 0.0;
+    bool multi_target_ = false;
+    int sheets_across_ = 1;
+    CalibrationCache* calibration_ = nullptr;
+    std::string lane_;
+
+    // Буферы между вызовами
+    IngestedImage ingested_;
+    cv::Mat rectified_;
+    AnalysisContext ctx_;
+
+    // Превью считается своим модулем оружия и своими буферами, пока полный анализ идет в фоне
+    double preview_pixels_per_cm_ = 10.0;
+    std::unique_ptr<Weapon> preview_weapon_;
+    IngestedImage preview_ingested_;
+    cv::Mat preview_rectified_, preview_small_;
+    AnalysisContext preview_ctx_;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef UNION_FIND_H
+#define UNION_FIND_H
+
+#include <vector>
+#include <cstddef>
+
+// Система непересекающихся множеств.
+// Корнем всегда становится меньший индекс, поэтому результат не зависит от порядка объединений.
+class UnionFind {
+public:
+    explicit UnionFind(size_t n = 0) { reset(n); }
+
+    void reset(size_t n) {
+        parent_.resize(n);
+        for (size_t i = 0; i < n; ++i) parent_[i] = (int)i;
+    }
+
+    // Новый одиночный элемент, возвращает его индекс
+    int add() {
+        parent_.push_back((int)parent_.size());
+        return (int)parent_.size() - 1;
+    }
+
+    int find(int x) {
+        while (parent_[x] != x) {
+            parent_[x] = parent_[parent_[x]];   // сжатие пути через одного
+            x = parent_[x];
+        }
+        return x;
+    }
+
+    int unite(int a, int b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return a;
+        if (b < a) std::swap(a, b);
+        parent_[b] = a;
+        return a;
+    }
+
+    size_t size() const { return parent_.size(); }
+
+private:
+    std::vector<int> parent_;
+};
+
+#endif
@@ -1,4 +1,6 @@
 #include "visualization.h"
+#include <opencv2/imgproc.hpp>
+#include "profiler.h"
 #include <iostream>
 #include <sstream>
 #include <iomanip>
@@ -18,88 +20,95 @@ void Visualization::drawShootingResult(Mat& image,
     const vector<DetectedHole>& all_detections,
     const Point2f& stp,
     const ShootingMetrics& metrics) {
-    
+
+    TL_PROFILE_SCOPE("render");
+    ShootingMetrics group_metrics = metrics;
+    group_metrics.stp = stp;
+    STPConstruction steps;
+    if (holes.size() == 4) ShootingMetricsCalculator().calculateSTP(holes, &steps);
+    drawGroup(image, all_detections, holes, steps, group_metrics);
+}
+
+void Visualization::drawShootingResult(Mat& image, const AnalysisContext& ctx) {
+    TL_PROFILE_SCOPE("render");
+    drawGroup(image, ctx.detections, ctx.shots, ctx.stp_steps, ctx.metrics);
+}
+
+void Visualization::drawGroup(Mat& image, const vector<DetectedHole>& detections, const vector<Point2f>& shots,
+    const STPConstruction& steps, const ShootingMetrics& metrics) {
+    const Point2f& stp = metrics.stp;
+
     //    (-) -  
-    for (const auto& detection : all_detections) {
+    for (const auto& detection : detections) {
         circle(image, detection.center, scaleToPixels(0.15), Scalar(180, 180, 180), scaleToPixels(0.03));
     }
     //  
     drawTargetCenter(image, metrics.target_center);
     //    ( )
-    drawHoles(image, holes);
+    drawHoles(image, shots);
 
     //    ( !)
     drawGroupCircle(image, stp, metrics.group_radius);
 
-    //  4     STP
-    if (holes.size() == 4) {
-        drawSTPProcess(image, holes, stp);
+    //  4     STP (    )
+    if (shots.size() == 4) {
+        drawSTPProcess(image, steps);
     }
+
     //     
     drawCenterLine(image, stp, metrics.target_center, metrics.distance_to_center_cm);
     //  
-   // drawMetrics(image, metrics, holes.size());
+   // drawMetrics(image, metrics, shots.size());
     //  
     drawSTP(image, stp);
 }
 
-void Visualization::drawSTPProcess(Mat& image, const vector<Point2f>& holes, const Point2f& stp) {
-    Scalar line_color(255, 255, 0);  //   
-    Scalar step_color(0, 255, 255);  //    
+void Visualization::drawTargetGroups(Mat& image, const AnalysisContext& ctx) {
+    TL_PROFILE_SCOPE("render_targets");
+    double text_scale = pixels_per_cm_ * 0.05;
 
-    //   
-    double min_dist = numeric_limits<double>::max();
-    pair<Point2f, Point2f> closest_pair;
-
-    for (int i = 0; i < 4; i++) {
-        for (int j = i + 1; j < 4; j++) {
-            double dist = norm(holes[i] - holes[j]);
-            if (dist < min_dist) {
-                min_dist = dist;
-                closest_pair = { holes[i], holes[j] };
-            }
-        }
-    }
+    for (size_t k = 0; k < ctx.targets.size(); ++k) {
+        const TargetGroup& g = ctx.targets[k];
 
-    Point2f M1 = (closest_pair.first + closest_pair.second) * 0.5f;
-    
-    //   
-    line(image, closest_pair.first, closest_pair.second, line_color, scaleToPixels(0.08));
-    circle(image, M1, scaleToPixels(0.1), step_color, -1);
-
-    //   
-    Point2f C;
-    double min_dist_to_M1 = numeric_limits<double>::max();
-
-    for (const auto& hole : holes) {
-        if (hole != closest_pair.first && hole != closest_pair.second) {
-            double dist = norm(hole - M1);
-            if (dist < min_dist_to_M1) {
-                min_dist_to_M1 = dist;
-                C = hole;
-            }
+        //     
+        putText(image, "#" + to_string(k + 1), g.target_center + Point2f(scaleToPixels(-1.0), scaleToPixels(-1.5)),
+            FONT_HERSHEY_SIMPLEX, text_scale, Scalar(255, 255, 255), scaleToPixels(0.08));
+
+        if (g.shots.empty()) {
+            drawTargetCenter(image, g.target_center);
+            continue;
         }
+
+        //     ,    ,   TargetGroup
+        drawGroup(image, g.detections, g.shots, g.stp_steps, g.metrics);
     }
+}
 
-    Point2f M2 = M1 + (C - M1) * (1.0f / 3.0f);
-    line(image, M1, C, line_color, scaleToPixels(0.08));
-    circle(image, M2, scaleToPixels(0.1), step_color, -1);
+void Visualization::drawSTPProcess(Mat& image, const vector<Point2f>& holes) {
+    if (holes.size() < 2) return;
 
-    //   
-    Point2f D;
-    for (const auto& hole : holes) {
-        if (hole != closest_pair.first && hole != closest_pair.second && hole != C) {
-            D = hole;
-            break;
-        }
-    }
+    STPConstruction steps;
+    ShootingMetricsCalculator().calculateSTP(holes, &steps);
+    drawSTPProcess(image, steps);
+}
 
-    line(image, M2, D, line_color, scaleToPixels(0.08));
+void Visualization::drawSTPProcess(Mat& image, const STPConstruction& steps) {
+    if (!steps.valid) return;
 
-    //     STP
-    /*for (const auto& hole : holes) {
-        line(image, hole, stp, Scalar(0, 255, 255), scaleToPixels(0.04));
-    }*/
+    Scalar line_color(255, 255, 0);  //   
+    Scalar step_color(0, 255, 255);  //    
+
+    const size_t n = steps.points.size();
+
+    //     
+    line(image, steps.points[0], steps.points[1], line_color, scaleToPixels(0.08));
+    if (n > 2) circle(image, steps.means[0], scaleToPixels(0.1), step_color, -1);
+
+    //  ;    
+    for (size_t k = 2; k < n; k++) {
+        line(image, steps.means[k - 2], steps.points[k], line_color, scaleToPixels(0.08));
+        if (k + 1 < n) circle(image, steps.means[k - 1], scaleToPixels(0.1), step_color, -1);
+    }
 }
 
 void Visualization::drawMetrics(Mat& image, const ShootingMetrics& metrics, int total_shots) {
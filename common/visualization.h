@@ -1,10 +1,11 @@
 #ifndef VISUALIZATION_H
 #define VISUALIZATION_H
 
-#include <opencv2/opencv.hpp>
+#include <opencv2/core.hpp>
 #include <vector>
 #include "shooting_metrics.h"
 #include "hole_detector.h"
+#include "analysis_context.h"
 
 class Visualization {
 public:
@@ -16,9 +17,16 @@ public:
         const cv::Point2f& stp,
         const ShootingMetrics& metrics);
 
-    void drawSTPProcess(cv::Mat& image,
-        const std::vector<cv::Point2f>& holes,
-        const cv::Point2f& stp);
+    //      ,   
+    void drawShootingResult(cv::Mat& image, const AnalysisContext& ctx);
+
+    //     (ctx.targets):   -   ,  
+    void drawTargetGroups(cv::Mat& image, const AnalysisContext& ctx);
+
+    //        (drawShootingResult     4)
+    void drawSTPProcess(cv::Mat& image, const std::vector<cv::Point2f>& holes);
+
+    void drawSTPProcess(cv::Mat& image, const STPConstruction& steps);
 
 private:
     double pixels_per_cm_;
@@ -26,6 +34,10 @@ private:
     //    
     int scaleToPixels(double cm);
 
+    //  : , ,    
+    void drawGroup(cv::Mat& image, const std::vector<DetectedHole>& detections, const std::vector<cv::Point2f>& shots,
+        const STPConstruction& steps, const ShootingMetrics& metrics);
+
     void drawHoles(cv::Mat& image, const std::vector<cv::Point2f>& holes);
     void drawSTP(cv::Mat& image, const cv::Point2f& stp);
     void drawMetrics(cv::Mat& image, const ShootingMetrics& metrics, int total_shots);
@@ -0,0 +1,78 @@
+#ifndef WEAPON_PROFILES_H
+#define WEAPON_PROFILES_H
+
+#include <cstddef>
+#include <vector>
+#include "red_classifier.h"
+
+// Профили упражнений: параметры детекции и правило выбора выстрелов.
+// Все значения - константы времени компиляции: детектор и оружие инстанцируются
+// отдельно под каждый профиль (BasicHoleDetector<Profile>, ProfiledWeapon<Profile>).
+//
+// Профиль должен объявлять:
+//   name()                                - имя для реестра и командной строки
+//   HOOK_ZONE_CM                          - верхняя зона листа с крючками
+//   MERGE_RADIUS_CM                       - радиус объединения фрагментов одной пробоины
+//   MIN_CLUSTER_AREA, MAX_CLUSTER_AREA    - площадь кластера, пикс
+//   MIN_SHOTS, MAX_SHOTS                  - добор из зоны крючков и ограничение кандидатов
+//   FULL_GROUP_SHOTS, SHORT_GROUP_SHOTS   - размер группы: полная, если кандидатов хватает, иначе короткая
+//   redHsvRanges()                        - пороги красного в HSV
+
+// Стандартные красные пороги наклеек
+inline std::vector<HsvRange> standardRedHsvRanges() {
+    return {
+        { cv::Scalar(0, 100, 50), cv::Scalar(10, 255, 255) },
+        { cv::Scalar(170, 100, 50), cv::Scalar(180, 255, 255) }
+    };
+}
+
+// ПМ, 9 мм: 4 или 10 выстрелов по листу A3
+struct PMProfile {
+    static const char* name() { return "pm"; }
+    static constexpr double HOOK_ZONE_CM = 7.0;
+    static constexpr double MERGE_RADIUS_CM = 1.5;
+    static constexpr int MIN_CLUSTER_AREA = 15;
+    static constexpr int MAX_CLUSTER_AREA = 5000;
+    static constexpr int MIN_SHOTS = 4;
+    static constexpr int MAX_SHOTS = 10;
+    static constexpr int FULL_GROUP_SHOTS = 10;
+    static constexpr int SHORT_GROUP_SHOTS = 4;
+    static std::vector<HsvRange> redHsvRanges() { return standardRedHsvRanges(); }
+};
+
+// АК, 7.62x39: серии по 5 или 10, наклейки крупнее, чем у ПМ
+struct AKProfile {
+    static const char* name() { return "ak"; }
+    static constexpr double HOOK_ZONE_CM = 7.0;
+    static constexpr double MERGE_RADIUS_CM = 2.0;
+    static constexpr int MIN_CLUSTER_AREA = 20;
+    static constexpr int MAX_CLUSTER_AREA = 8000;
+    static constexpr int MIN_SHOTS = 5;
+    static constexpr int MAX_SHOTS = 10;
+    static constexpr int FULL_GROUP_SHOTS = 10;
+    static constexpr int SHORT_GROUP_SHOTS = 5;
+    static std::vector<HsvRange> redHsvRanges() { return standardRedHsvRanges(); }
+};
+
+// Винтовка: кучность по 3 или 5 выстрелам, пробоины мелкие и плотные
+struct RifleProfile {
+    static const char* name() { return "rifle"; }
+    static constexpr double HOOK_ZONE_CM = 7.0;
+    static constexpr double MERGE_RADIUS_CM = 1.0;
+    static constexpr int MIN_CLUSTER_AREA = 10;
+    static constexpr int MAX_CLUSTER_AREA = 5000;
+    static constexpr int MIN_SHOTS = 3;
+    static constexpr int MAX_SHOTS = 5;
+    static constexpr int FULL_GROUP_SHOTS = 5;
+    static constexpr int SHORT_GROUP_SHOTS = 3;
+    static std::vector<HsvRange> redHsvRanges() { return standardRedHsvRanges(); }
+};
+
+// Число выстрелов группы по числу кандидатов детектора
+template <typename Profile>
+constexpr int expectedShots(size_t detections) {
+    return (int)(detections >= (size_t)Profile::FULL_GROUP_SHOTS ? (size_t)Profile::FULL_GROUP_SHOTS
+        : detections >= (size_t)Profile::SHORT_GROUP_SHOTS ? (size_t)Profile::SHORT_GROUP_SHOTS : detections);
+}
+
+#endif
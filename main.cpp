@@ -1,47 +1,156 @@
 #include <opencv2/opencv.hpp>
 #include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <cstdlib>
 #include "weapons/pm.h"
+#include "weapons/weapon_registry.h"
 #include "common/visualization.h"
+#include "common/batch_processor.h"
+#include "common/batch_pipeline.h"
+#include "common/stream_tracker.h"
+#include "common/image_ingest.h"
+#include "common/profiler.h"
+#include "common/logger.h"
+#include "common/debug_artifacts.h"
+#include "common/result_writer.h"
+#include "common/result_cache.h"
+#include "common/sheet_calibration.h"
+#include "common/shot_history.h"
+#include "common/analysis_server.h"
+#include <csignal>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <ctime>
 
 using namespace cv;
 using namespace std;
 
-int main() {
-    cout << "=== SHOOTING ANALYZER ===" << endl;
+static void printUsage(const char* argv0) {
+    cout << "Usage:" << endl;
+    cout << "  " << argv0 << "                              analyze target.jpg interactively" << endl;
+    cout << "  " << argv0 << " --batch <dir|list> [--threads N]   headless batch analysis" << endl;
+    cout << "  " << argv0 << " --stream <video|camera index>      report new holes as they appear" << endl;
+    cout << "  " << argv0 << " --daemon <socket> [--threads N] [--queue N]   serve requests over a UNIX socket" << endl;
+    cout << "Options:" << endl;
+    cout << "  --pyramid         detect on a downscaled copy and refine in full-resolution windows" << endl;
+    cout << "  --hook-first      scan below the hook zone first, the whole sheet only if holes are missing" << endl;
+    cout << "  --target-ppc X    decode JPEG at a reduced scale that keeps at least X px/cm" << endl;
+    cout << "  --profile F       write per-stage timing histograms to F as JSON" << endl;
+    cout << "  --weapon NAME     exercise profile:";
+    for (const auto& name : weaponNames()) cout << " " << name;
+    cout << " (default pm)" << endl;
+    cout << "  --lane ID         find the sheet corners once per lane and rectify every image" << endl;
+    cout << "  --rectify-ppc X   scale of the rectified sheet, px/cm (default 20)" << endl;
+    cout << "  --multi           several aiming targets on one sheet: one group per target (single image only)" << endl;
+    cout << "  --sheets N        N portrait A3 sheets side by side in the frame (pixel scale)" << endl;
+    cout << "  --verbose         print detector debug log to stderr" << endl;
+    cout << "  --out F           batch: write one record per image to F instead of console lines" << endl;
+    cout << "  --pipeline        batch: decode, detect and render in separate stages with their own threads" << endl;
+    cout << "  --render DIR      batch: write annotated images to DIR (implies --pipeline)" << endl;
+    cout << "  --decode-threads N, --render-threads N   thread budgets of the I/O stages (--threads - detection)" << endl;
+    cout << "  --format FMT      record format for --out: jsonl (default), csv, bin" << endl;
+    cout << "  --cache DIR       batch/daemon: reuse results of unchanged images and parameters from DIR" << endl;
+    cout << "  --cache-mb N      size limit of the result cache (default 256 MB)" << endl;
+    cout << "  --history DIR     append the results to the shot history in DIR" << endl;
+    cout << "  --shooter NAME    shooter for --history records and --history-report" << endl;
+    cout << "  --history-report DIR [--bucket-days N]   summary and trend of the history" << endl;
+}
+
+// Запись в историю стрельб: время снимка - время изменения файла
+struct HistoryOptions {
+    ShotHistoryWriter* writer = nullptr;
+    string shooter;
+};
+
+static int64_t fileTime(const string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return (int64_t)time(nullptr);
+    return (int64_t)st.st_mtime;
+}
 
-    Mat image = imread("target.jpg");
-    if (image.empty()) {
+static int runInteractive(const BatchOptions& options, bool multi_target, const HistoryOptions& history) {
+    IngestOptions ingest_options;
+    ingest_options.target_pixels_per_cm = options.target_pixels_per_cm;
+    IngestedImage ingested;
+    if (!ingestImage("target.jpg", ingest_options, ingested)) {
         cerr << "Cannot load target.jpg!" << endl;
         return -1;
     }
+    Mat image = ingested.image;
+    if (options.calibration) {
+        Mat rectified;
+        auto cal = options.calibration->rectify(options.lane, image, rectified);
+        cout << "Sheet " << (cal->sheet_found ? "found" : "not found") << ", "
+             << fixed << setprecision(2) << cal->source_pixels_per_cm << " px/cm in the photo" << endl;
+        image = rectified;
+    }
 
     cout << "Image: " << image.cols << "x" << image.rows << endl;
 
-    // Используем модуль ПМ
-    PMWeapon pm;
+    // Модуль оружия по профилю упражнения (по умолчанию ПМ)
+    unique_ptr<Weapon> weapon = createWeapon(options.weapon);
 
-    // Детекция пробоин
-    auto hole_centers = pm.detectHoles(image);
-    if (hole_centers.empty()) {
-        cerr << "No holes detected!" << endl;
-        return -1;
+    // Детекция пробоин и метрики за один проход
+    // Интерактивный режим сохраняет маску красного рядом с результатом
+    FileArtifactSink artifacts;
+    AnalysisContext ctx(image);
+    ctx.coarse_to_fine = options.coarse_to_fine;
+    ctx.hook_zone_first = options.hook_zone_first;
+    ctx.artifacts = &artifacts;
+    // Как в пакетном режиме: пороги площади профиля заданы для полного разрешения
+    if (!options.calibration) ctx.area_scale = 1.0 / ((double)ingested.reduction * ingested.reduction);
+    if (options.sheets_across > 1) {
+        ctx.preset_pixels_per_cm = HoleDetectorBase::sheetsPixelsPerCM(image.size(), options.sheets_across);
     }
 
-    // Вычисление метрик
-    HoleDetector detector;
-    double pixels_per_cm = detector.calculatePixelsPerCM(image);
-    ShootingMetrics metrics = pm.calculateMetrics(hole_centers, pixels_per_cm, image);
+    if (multi_target) {
+        weapon->analyzeTargets(ctx);
+        Logger::flushAll();
+        size_t groups_with_shots = 0;
+        for (size_t k = 0; k < ctx.targets.size(); ++k) {
+            const TargetGroup& g = ctx.targets[k];
+            if (!g.shots.empty()) groups_with_shots++;
+            cout << "Target #" << k + 1 << ": shots=" << g.shots.size() << fixed << setprecision(2)
+                 << " group_radius=" << g.metrics.group_radius_cm << "cm"
+                 << " to_center=" << g.metrics.distance_to_center_cm << "cm" << endl;
+        }
+        if (groups_with_shots == 0) {
+            cerr << "No holes detected!" << endl;
+            return -1;
+        }
+        if (history.writer) {
+            for (const auto& g : ctx.targets) {
+                if (g.shots.empty()) continue;
+                history.writer->append(makeHistoryRecord(fileTime("target.jpg"), history.shooter, options.weapon,
+                    g.metrics, g.shots, ctx.pixels_per_cm));
+            }
+        }
+    } else {
+        weapon->analyze(ctx);
+        Logger::flushAll();
+        if (ctx.shots.empty()) {
+            cerr << "No holes detected!" << endl;
+            return -1;
+        }
+        if (history.writer) {
+            history.writer->append(makeHistoryRecord(fileTime("target.jpg"), history.shooter, options.weapon,
+                ctx.metrics, ctx.shots, ctx.pixels_per_cm));
+        }
+    }
 
     // Визуализация
-    Visualization visualizer(pixels_per_cm);
+    Visualization visualizer(ctx.pixels_per_cm);
     Mat result = image.clone();
 
-    // Получаем все детекции для визуализации
-    auto all_detections = detector.detectHoles(image, false);
-
-    visualizer.drawShootingResult(result, hole_centers, all_detections, metrics.stp, metrics);
+    if (multi_target) visualizer.drawTargetGroups(result, ctx);
+    else visualizer.drawShootingResult(result, ctx);
 
-    imwrite("shooting_result.jpg", result);
+    {
+        TL_PROFILE_SCOPE("encode");
+        imwrite("shooting_result.jpg", result);
+    }
 
     namedWindow("Shooting Analysis", WINDOW_NORMAL);
     resizeWindow("Shooting Analysis", 1000, 800);
@@ -49,4 +158,344 @@ int main() {
 
     waitKey(0);
     return 0;
-}
\ No newline at end of file
+}
+
+static int runBatch(const string& source, const BatchOptions& options, const PipelineOptions* pipeline,
+    const HistoryOptions& history) {
+    vector<string> paths = BatchProcessor::collectInputs(source);
+    if (paths.empty()) {
+        cerr << "No images found in " << source << endl;
+        return -1;
+    }
+
+    cout << "Batch: " << paths.size() << " images" << endl;
+
+    // Конвейер нужен для отрисовки и при дорогом декодировании; иначе каждый поток ведет снимок целиком
+    int64 start = getTickCount();
+    vector<BatchItemResult> results;
+    if (pipeline) results = BatchPipeline(options, *pipeline).run(paths);
+    else results = BatchProcessor(options).run(paths);
+    double elapsed = (getTickCount() - start) / getTickFrequency();
+
+    // Одна строка результата на снимок, в порядке входного списка (если не пишется файл результатов)
+    int failed = 0;
+    for (const auto& r : results) {
+        if (!r.ok) {
+            failed++;
+            if (!options.writer) cout << r.path << ": ERROR " << r.error << endl;
+            continue;
+        }
+        if (options.writer) continue;
+        cout << r.path << fixed << setprecision(2)
+             << ": shots=" << r.holes.size()
+             << " stp=(" << r.metrics.stp.x << "," << r.metrics.stp.y << ")"
+             << " precision=" << r.metrics.precision_cm << "cm"
+             << " group_radius=" << r.metrics.group_radius_cm << "cm"
+             << " to_center=" << r.metrics.distance_to_center_cm << "cm" << endl;
+    }
+
+    if (history.writer) {
+        for (const auto& r : results) {
+            if (!r.ok) continue;
+            history.writer->append(makeHistoryRecord(fileTime(r.path), history.shooter, options.weapon,
+                r.metrics, r.holes, r.pixels_per_cm));
+        }
+    }
+
+    cout << "Processed " << results.size() << " images (" << failed << " failed";
+    if (options.cache) cout << ", " << options.cache->hits() << " from cache";
+    cout << ") in " << fixed << setprecision(2) << elapsed << " s, "
+         << results.size() / max(elapsed, 1e-9) << " img/s" << endl;
+    return failed == (int)results.size() ? -1 : 0;
+}
+
+static int runStream(const string& source, const BatchOptions& options) {
+    VideoCapture capture;
+    bool is_camera = !source.empty() && source.find_first_not_of("0123456789") == string::npos;
+    if (is_camera) capture.open(atoi(source.c_str()));
+    else capture.open(source);
+
+    if (!capture.isOpened()) {
+        cerr << "Cannot open stream " << source << endl;
+        return -1;
+    }
+
+    // Трекер ищет кластеры сам, но по порогам того же профиля, что выбирает выстрелы
+    unique_ptr<Weapon> weapon = createWeapon(options.weapon);
+    StreamHoleTracker tracker(weapon->detectionLimits());
+    weapon->setReuseLastCenter(true);   // неподвижная камера: центр мишени ищется от центра предыдущего кадра
+    Mat frame, rectified;
+    AnalysisContext ctx;
+    int frame_index = 0;
+
+    for (;;) {
+        {
+            TL_PROFILE_SCOPE("decode");
+            if (!capture.read(frame)) break;
+        }
+
+        // Неподвижная камера: калибровка по первому кадру, дальше только remap
+        Mat sheet = frame;
+        if (options.calibration) {
+            options.calibration->rectify(options.lane, frame, rectified);
+            sheet = rectified;
+        }
+
+        StreamFrameResult r = tracker.processFrame(sheet);
+        if (r.full_scan) {
+            cout << "Frame " << frame_index << ": initial scan, " << tracker.holes().size() << " holes" << endl;
+        } else {
+            for (const auto& h : r.new_holes) {
+                cout << "Frame " << frame_index << ": new hole at (" << fixed << setprecision(1)
+                     << h.center.x << "," << h.center.y << "), " << r.changed_tiles << " tiles rescanned" << endl;
+            }
+        }
+
+        // Метрики после каждой новой пробоины: выстрелы выбираются из всех известных пробоин
+        // по правилам профиля (зона крючков, MIN_SHOTS/MAX_SHOTS, размер группы)
+        if (!r.new_holes.empty() || r.full_scan) {
+            ctx.reset(sheet);
+            ctx.pixels_per_cm = tracker.pixelsPerCM();
+            ctx.merged = tracker.holes();
+            weapon->selectShots(ctx);
+            if (!ctx.shots.empty()) {
+                weapon->calculateMetrics(ctx);
+                cout << "  shots=" << ctx.shots.size() << fixed << setprecision(2)
+                     << " group_radius=" << ctx.metrics.group_radius_cm << "cm"
+                     << " to_center=" << ctx.metrics.distance_to_center_cm << "cm" << endl;
+            }
+        }
+        frame_index++;
+    }
+
+    cout << "Stream finished: " << frame_index << " frames, " << tracker.holes().size() << " holes" << endl;
+    return 0;
+}
+
+static AnalysisServer* active_server = nullptr;
+
+static void stopServer(int) {
+    if (active_server) active_server->stop();
+}
+
+static int runDaemon(const string& socket_path, const BatchOptions& options, CalibrationCache& calibration,
+    size_t queue_capacity) {
+    ServerOptions server_options;
+    server_options.socket_path = socket_path;
+    server_options.workers = options.num_threads;
+    server_options.queue_capacity = queue_capacity;
+    server_options.analysis = options;
+    server_options.calibration = &calibration;
+
+    // Анализ каждого запроса идет в одном потоке пула, без вложенного распараллеливания
+    setNumThreads(1);
+
+    AnalysisServer server;
+    string error;
+    if (!server.start(server_options, &error)) {
+        cerr << error << endl;
+        return -1;
+    }
+    cout << "Listening on " << socket_path << endl;
+
+    active_server = &server;
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    server.run();
+    active_server = nullptr;
+
+    cout << "Daemon stopped after " << server.served() << " requests" << endl;
+    return 0;
+}
+
+static int runHistoryReport(const string& directory, const HistoryQuery& query, int bucket_days) {
+    ShotHistoryReader reader;
+    if (!reader.open(directory)) {
+        cerr << "Cannot open shot history " << directory << endl;
+        return -1;
+    }
+
+    HistorySummary summary = reader.summarize(query);
+    cout << "History: " << reader.size() << " records, " << summary.count << " selected" << endl;
+    if (summary.count == 0) return 0;
+
+    cout << fixed << setprecision(2)
+         << "Mean: precision=" << summary.mean_precision_cm << "cm"
+         << " group_radius=" << summary.mean_group_radius_cm << "cm"
+         << " (p50 " << summary.group_radius_p50_cm << ", p90 " << summary.group_radius_p90_cm << ")"
+         << " to_center=" << summary.mean_distance_cm << "cm"
+         << " stp_offset=(" << summary.mean_stp_offset_cm.x << "," << summary.mean_stp_offset_cm.y << ")cm" << endl;
+
+    for (const auto& b : reader.trend(query, (int64_t)bucket_days * 86400)) {
+        time_t start = (time_t)b.start;
+        char date[16];
+        strftime(date, sizeof(date), "%Y-%m-%d", gmtime(&start));
+        cout << date << ": n=" << b.count
+             << " stp_offset=(" << b.mean_stp_offset_cm.x << "," << b.mean_stp_offset_cm.y << ")cm"
+             << " group_radius=" << b.mean_group_radius_cm << "cm"
+             << " to_center=" << b.mean_distance_cm << "cm" << endl;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    cout << "=== SHOOTING ANALYZER ===" << endl;
+
+    string batch_source;
+    string stream_source;
+    BatchOptions options;
+    string profile_path;
+    string out_path;
+    bool use_calibration = false;
+    bool multi_target = false;
+    double rectify_ppc = 20.0;
+    ResultFormat out_format = ResultFormat::JsonLines;
+    string history_path;
+    string daemon_socket;
+    size_t queue_capacity = 0;
+    string report_path;
+    string shooter;
+    bool weapon_set = false;
+    int bucket_days = 30;
+    PipelineOptions pipeline;
+    bool pipelined = false;
+    string cache_path;
+    size_t cache_mb = 256;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--batch" && i + 1 < argc) {
+            batch_source = argv[++i];
+        } else if (arg == "--stream" && i + 1 < argc) {
+            stream_source = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.num_threads = atoi(argv[++i]);
+        } else if (arg == "--pyramid") {
+            options.coarse_to_fine = true;
+        } else if (arg == "--hook-first") {
+            options.hook_zone_first = true;
+        } else if (arg == "--pipeline") {
+            pipelined = true;
+        } else if (arg == "--render" && i + 1 < argc) {
+            pipeline.render_dir = argv[++i];
+            pipelined = true;
+        } else if (arg == "--decode-threads" && i + 1 < argc) {
+            pipeline.decode_threads = atoi(argv[++i]);
+        } else if (arg == "--render-threads" && i + 1 < argc) {
+            pipeline.render_threads = atoi(argv[++i]);
+        } else if (arg == "--target-ppc" && i + 1 < argc) {
+            options.target_pixels_per_cm = atof(argv[++i]);
+        } else if (arg == "--profile" && i + 1 < argc) {
+            profile_path = argv[++i];
+        } else if (arg == "--out" && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (arg == "--format" && i + 1 < argc && parseResultFormat(argv[i + 1], out_format)) {
+            ++i;
+        } else if (arg == "--weapon" && i + 1 < argc && createWeapon(argv[i + 1])) {
+            options.weapon = argv[++i];
+            weapon_set = true;
+        } else if (arg == "--lane" && i + 1 < argc) {
+            use_calibration = true;
+            options.lane = argv[++i];
+        } else if (arg == "--rectify-ppc" && i + 1 < argc) {
+            rectify_ppc = atof(argv[++i]);
+        } else if (arg == "--multi") {
+            multi_target = true;
+        } else if (arg == "--sheets" && i + 1 < argc) {
+            options.sheets_across = max(1, atoi(argv[++i]));
+        } else if (arg == "--daemon" && i + 1 < argc) {
+            daemon_socket = argv[++i];
+        } else if (arg == "--queue" && i + 1 < argc) {
+            queue_capacity = (size_t)max(0, atoi(argv[++i]));
+        } else if (arg == "--cache" && i + 1 < argc) {
+            cache_path = argv[++i];
+        } else if (arg == "--cache-mb" && i + 1 < argc) {
+            cache_mb = (size_t)max(1, atoi(argv[++i]));
+        } else if (arg == "--history" && i + 1 < argc) {
+            history_path = argv[++i];
+        } else if (arg == "--history-report" && i + 1 < argc) {
+            report_path = argv[++i];
+        } else if (arg == "--shooter" && i + 1 < argc) {
+            shooter = argv[++i];
+        } else if (arg == "--bucket-days" && i + 1 < argc) {
+            bucket_days = max(1, atoi(argv[++i]));
+        } else if (arg == "--verbose") {
+            Logger::setLevel(LogLevel::Debug);
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (!report_path.empty()) {
+        HistoryQuery query;
+        query.shooter = shooter;
+        if (weapon_set) query.weapon = options.weapon;
+        return runHistoryReport(report_path, query, bucket_days);
+    }
+
+    // Группы по мишеням есть только в интерактивном режиме: пакетные результаты, кэш и ответы
+    // резидентного режима хранят одну группу на снимок
+    if (multi_target && (!batch_source.empty() || !stream_source.empty() || !daemon_socket.empty())) {
+        cerr << "--multi is supported only for a single image, not with --batch, --stream or --daemon" << endl;
+        return -1;
+    }
+
+    if (!profile_path.empty()) StageProfiler::setEnabled(true);
+
+    CalibrationCache calibration(rectify_ppc);
+    if (use_calibration) options.calibration = &calibration;
+
+    ResultWriter writer;
+    if (!out_path.empty()) {
+        if (batch_source.empty()) {
+            printUsage(argv[0]);
+            return -1;
+        }
+        if (!writer.open(out_path, out_format)) {
+            cerr << "Cannot write results to " << out_path << endl;
+            return -1;
+        }
+        options.writer = &writer;
+    }
+
+    ResultCache cache;
+    if (!cache_path.empty()) {
+        string error;
+        if (!cache.open(cache_path, cache_mb << 20, &error)) {
+            cerr << "Cannot open result cache: " << error << endl;
+            return -1;
+        }
+        options.cache = &cache;
+    }
+
+    ShotHistoryWriter history_writer;
+    HistoryOptions history;
+    history.shooter = shooter;
+    if (!history_path.empty()) {
+        if (!history_writer.open(history_path)) {
+            cerr << "Cannot open shot history " << history_path << endl;
+            return -1;
+        }
+        history.writer = &history_writer;
+    }
+
+    int rc;
+    if (!daemon_socket.empty()) rc = runDaemon(daemon_socket, options, calibration, queue_capacity);
+    else if (!batch_source.empty()) rc = runBatch(batch_source, options, pipelined ? &pipeline : nullptr, history);
+    else if (!stream_source.empty()) rc = runStream(stream_source, options);
+    else rc = runInteractive(options, multi_target, history);
+    history_writer.close();
+    cache.close();
+    Logger::flushAll();
+
+    if (!profile_path.empty()) {
+        ofstream out(profile_path);
+        if (!out) {
+            cerr << "Cannot write profile to " << profile_path << endl;
+        } else {
+            StageProfiler::writeJson(out);
+        }
+    }
+    return rc;
+}
@@ -1,19 +1,18 @@
 #ifndef PM_WEAPON_H
 #define PM_WEAPON_H
 
-#include <opencv2/opencv.hpp>
+#include <opencv2/core.hpp>
 #include <vector>
-#include "../common/hole_detector.h"
-#include "../common/shooting_metrics.h"
+#include "weapon.h"
 
-class PMWeapon {
+// ПМ: профиль PMProfile плюс прежний интерфейс на cv::Mat
+class PMWeapon : public ProfiledWeapon<PMProfile> {
 public:
-    std::vector<cv::Point2f> detectHoles(const cv::Mat& image);
-    ShootingMetrics calculateMetrics(const std::vector<cv::Point2f>& holes, double pixels_per_cm, const cv::Mat& image);
+    using ProfiledWeapon<PMProfile>::detectHoles;
+    using ProfiledWeapon<PMProfile>::calculateMetrics;
 
-private:
-    HoleDetector detector_;
-    ShootingMetricsCalculator metrics_calc_;
+    std::vector<cv::Point2f> detectHoles(const cv::Mat& image, bool debug = true);
+    ShootingMetrics calculateMetrics(const std::vector<cv::Point2f>& holes, double pixels_per_cm, const cv::Mat& image);
 };
 
-#endif
\ No newline at end of file
+#endif
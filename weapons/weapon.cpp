@@ -0,0 +1,143 @@
+#include "weapon.h"
+#include "../common/profiler.h"
+#include "../common/logger.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+// Метрики группы относительно известного центра мишени
+void groupMetrics(ShootingMetricsCalculator& calc, const vector<Point2f>& shots, const Point2f& target_center,
+    double pixels_per_cm, STPConstruction* steps, ShootingMetrics& out) {
+    ShootingMetrics metrics = calc.calculateMetrics(shots, pixels_per_cm, steps);
+
+    metrics.target_center = target_center;
+    metrics.distance_to_center_cm = round((norm(metrics.stp - target_center) / pixels_per_cm) * 100.0) / 100.0;
+
+    out = metrics;
+}
+
+// Выбор выстрелов и метрики каждой мишени - отдельной задачей
+template <typename Profile>
+class TargetGroupBody : public ParallelLoopBody {
+public:
+    TargetGroupBody(BasicHoleDetector<Profile>& detector, const vector<vector<DetectedHole>>& parts,
+        double pixels_per_cm, vector<TargetGroup>& groups)
+        : detector_(detector), parts_(parts), pixels_per_cm_(pixels_per_cm), groups_(groups) {}
+
+    void operator()(const Range& range) const override {
+        ShootingMetricsCalculator calc;
+        for (int k = range.start; k < range.end; ++k) {
+            TargetGroup& g = groups_[k];
+            detector_.selectCandidates(parts_[k], pixels_per_cm_, g.detections);
+
+            int expected_shots = expectedShots<Profile>(g.detections.size());
+            g.shots.clear();
+            for (int i = 0; i < expected_shots; i++) g.shots.push_back(g.detections[i].center);
+            if (g.shots.empty()) continue;
+
+            groupMetrics(calc, g.shots, g.target_center, pixels_per_cm_, &g.stp_steps, g.metrics);
+        }
+    }
+
+private:
+    BasicHoleDetector<Profile>& detector_;
+    const vector<vector<DetectedHole>>& parts_;
+    double pixels_per_cm_;
+    vector<TargetGroup>& groups_;
+};
+
+}
+
+template <typename Profile>
+void ProfiledWeapon<Profile>::analyze(AnalysisContext& ctx) {
+    TL_PROFILE_SCOPE("analyze_total");
+    detectHoles(ctx);
+    if (!ctx.shots.empty()) calculateMetrics(ctx);
+}
+
+// Выстрелы - первые кандидаты в числе, которое задает профиль
+template <typename Profile>
+static void takeShots(AnalysisContext& ctx) {
+    ctx.shots.clear();
+
+    const auto& all_detections = ctx.detections;
+    if (all_detections.empty()) {
+        TL_LOG_DEBUG("No holes detected");
+        return;
+    }
+
+    // Полная группа, если кандидатов хватает, иначе короткая
+    int expected_shots = expectedShots<Profile>(all_detections.size());
+
+    for (int i = 0; i < expected_shots; i++) {
+        ctx.shots.push_back(all_detections[i].center);
+    }
+}
+
+template <typename Profile>
+void ProfiledWeapon<Profile>::detectHoles(AnalysisContext& ctx) {
+    detector_.detectHoles(ctx);
+    takeShots<Profile>(ctx);
+}
+
+template <typename Profile>
+void ProfiledWeapon<Profile>::selectShots(AnalysisContext& ctx) {
+    detector_.selectCandidates(ctx.merged, ctx.pixels_per_cm, ctx.detections);
+    takeShots<Profile>(ctx);
+}
+
+template <typename Profile>
+void ProfiledWeapon<Profile>::calculateMetrics(AnalysisContext& ctx) {
+    Point2f target_center = metrics_calc_.findTargetCenter(ctx.image, ctx.pyramid_scale);
+    groupMetrics(metrics_calc_, ctx.shots, target_center, ctx.pixels_per_cm, &ctx.stp_steps, ctx.metrics);
+}
+
+template <typename Profile>
+void ProfiledWeapon<Profile>::analyzeTargets(AnalysisContext& ctx) {
+    TL_PROFILE_SCOPE("analyze_targets");
+    ctx.targets.clear();
+    ctx.shots.clear();
+
+    // Одна детекция на весь снимок, без разбиения на мишени: маска красного и связные компоненты
+    // и так считаются параллельно полосами. Зона крючков относится к листу, а не к мишеням:
+    // пробоины распределяются по мишеням со всего листа. По мишеням параллельны только выбор
+    // выстрелов и метрики - задачей на мишень
+    const bool hook_zone_first = ctx.hook_zone_first;
+    ctx.hook_zone_first = false;
+    detector_.detectHoles(ctx);
+    ctx.hook_zone_first = hook_zone_first;
+
+    vector<Point2f> centers = metrics_calc_.findTargetCenters(ctx.image, ctx.pyramid_scale);
+    if (centers.empty()) centers.push_back(metrics_calc_.findTargetCenter(ctx.image, ctx.pyramid_scale));
+
+    // Каждая пробоина - к ближайшей мишени (порядок по размеру сохраняется)
+    vector<vector<DetectedHole>> parts(centers.size());
+    for (const auto& hole : ctx.merged) {
+        size_t nearest = 0;
+        double best = -1;
+        for (size_t k = 0; k < centers.size(); ++k) {
+            Point2f d = hole.center - centers[k];
+            double dist_sq = (double)d.x * d.x + (double)d.y * d.y;
+            if (best < 0 || dist_sq < best) {
+                best = dist_sq;
+                nearest = k;
+            }
+        }
+        parts[nearest].push_back(hole);
+    }
+
+    ctx.targets.resize(centers.size());
+    for (size_t k = 0; k < centers.size(); ++k) ctx.targets[k].target_center = centers[k];
+
+    parallel_for_(Range(0, (int)centers.size()),
+        TargetGroupBody<Profile>(detector_, parts, ctx.pixels_per_cm, ctx.targets), (double)centers.size());
+    TL_LOG_DEBUG("Targets: " << ctx.targets.size());
+}
+
+template class ProfiledWeapon<PMProfile>;
+template class ProfiledWeapon<AKProfile>;
+template class ProfiledWeapon<RifleProfile>;
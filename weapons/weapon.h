@@ -0,0 +1,63 @@
+#ifndef WEAPON_H
+#define WEAPON_H
+
+#include <opencv2/core.hpp>
+#include "../common/hole_detector.h"
+#include "../common/shooting_metrics.h"
+#include "../common/analysis_context.h"
+#include "../common/weapon_profiles.h"
+
+// Оружие/упражнение с выбором во время выполнения (см. weapon_registry.h).
+// Виртуальный вызов - один на снимок; внутри все пороги профиля - константы компиляции.
+class Weapon {
+public:
+    virtual ~Weapon() {}
+    virtual const char* name() const = 0;
+
+    // Полный анализ снимка за один проход: детекция, выбор выстрелов, метрики
+    // Отладочные изображения - через ctx.artifacts
+    virtual void analyze(AnalysisContext& ctx) = 0;
+    virtual void detectHoles(AnalysisContext& ctx) = 0;
+    virtual void calculateMetrics(AnalysisContext& ctx) = 0;
+
+    // Выбор выстрелов из готовых кандидатов ctx.merged (объединенные пробоины по убыванию площади,
+    // масштаб - ctx.pixels_per_cm) по правилам профиля, без детекции: ctx.detections и ctx.shots
+    virtual void selectShots(AnalysisContext& ctx) = 0;
+
+    // Лист с несколькими мишенями: пробоины делятся по ближайшей мишени,
+    // результат - в ctx.targets (по группе на мишень, в порядке чтения)
+    virtual void analyzeTargets(AnalysisContext& ctx) = 0;
+
+    // Поиск центра мишени от центра предыдущего снимка (ShootingMetricsCalculator::setReuseLastCenter)
+    virtual void setReuseLastCenter(bool reuse) = 0;
+
+    // Пороги детекции профиля: для StreamHoleTracker, который ищет кластеры сам
+    virtual DetectionLimits detectionLimits() const = 0;
+};
+
+template <typename Profile>
+class ProfiledWeapon : public Weapon {
+public:
+    const char* name() const override { return Profile::name(); }
+
+    void analyze(AnalysisContext& ctx) override;
+    void detectHoles(AnalysisContext& ctx) override;
+    void calculateMetrics(AnalysisContext& ctx) override;
+    void selectShots(AnalysisContext& ctx) override;
+    void analyzeTargets(AnalysisContext& ctx) override;
+    void setReuseLastCenter(bool reuse) override { metrics_calc_.setReuseLastCenter(reuse); }
+    DetectionLimits detectionLimits() const override { return BasicHoleDetector<Profile>::limits(); }
+
+protected:
+    BasicHoleDetector<Profile> detector_;
+    ShootingMetricsCalculator metrics_calc_;
+};
+
+extern template class ProfiledWeapon<PMProfile>;
+extern template class ProfiledWeapon<AKProfile>;
+extern template class ProfiledWeapon<RifleProfile>;
+
+typedef ProfiledWeapon<AKProfile> AKWeapon;
+typedef ProfiledWeapon<RifleProfile> RifleWeapon;
+
+#endif
@@ -0,0 +1,66 @@
+#include "weapon_registry.h"
+#include "pm.h"
+#include "../common/content_hash.h"
+
+using namespace std;
+
+namespace {
+
+struct WeaponEntry {
+    const char* name;
+    unique_ptr<Weapon> (*create)();
+    uint64_t (*parameters)();
+};
+
+template <typename W>
+unique_ptr<Weapon> makeWeapon() {
+    return unique_ptr<Weapon>(new W());
+}
+
+// Отпечаток всех параметров профиля - часть ключа кэша результатов (result_cache.h):
+// изменение любого порога делает прежние результаты профиля недействительными.
+// Здесь, а не в weapon_profiles.h: профили не зависят от кэша
+template <typename Profile>
+uint64_t profileParameterHash() {
+    static const uint64_t hash = [] {
+        ParameterHasher h;
+        h.add(Profile::name()).add(Profile::HOOK_ZONE_CM).add(Profile::MERGE_RADIUS_CM);
+        h.add(Profile::MIN_CLUSTER_AREA).add(Profile::MAX_CLUSTER_AREA);
+        h.add(Profile::MIN_SHOTS).add(Profile::MAX_SHOTS);
+        h.add(Profile::FULL_GROUP_SHOTS).add(Profile::SHORT_GROUP_SHOTS);
+        for (const auto& range : Profile::redHsvRanges()) {
+            for (int c = 0; c < 3; ++c) h.add(range.lower[c]).add(range.upper[c]);
+        }
+        return h.value();
+    }();
+    return hash;
+}
+
+// Новый профиль: структура в weapon_profiles.h, инстанцирование детектора и оружия, строка здесь
+const WeaponEntry WEAPONS[] = {
+    { PMProfile::name(), &makeWeapon<PMWeapon>, &profileParameterHash<PMProfile> },
+    { AKProfile::name(), &makeWeapon<AKWeapon>, &profileParameterHash<AKProfile> },
+    { RifleProfile::name(), &makeWeapon<RifleWeapon>, &profileParameterHash<RifleProfile> },
+};
+
+}
+
+unique_ptr<Weapon> createWeapon(const string& name) {
+    for (const auto& entry : WEAPONS) {
+        if (name == entry.name) return entry.create();
+    }
+    return nullptr;
+}
+
+uint64_t weaponParameterHash(const string& name) {
+    for (const auto& entry : WEAPONS) {
+        if (name == entry.name) return entry.parameters();
+    }
+    return 0;
+}
+
+vector<string> weaponNames() {
+    vector<string> names;
+    for (const auto& entry : WEAPONS) names.push_back(entry.name);
+    return names;
+}
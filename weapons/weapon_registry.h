@@ -0,0 +1,19 @@
+#ifndef WEAPON_REGISTRY_H
+#define WEAPON_REGISTRY_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "weapon.h"
+
+// Оружие по имени профиля ("pm", "ak", "rifle"); nullptr для неизвестного имени
+std::unique_ptr<Weapon> createWeapon(const std::string& name);
+
+// Отпечаток параметров профиля (пороги, площади, радиус объединения, размер группы); 0 для неизвестного имени
+uint64_t weaponParameterHash(const std::string& name);
+
+// Имена зарегистрированных профилей
+std::vector<std::string> weaponNames();
+
+#endif